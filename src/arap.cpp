@@ -1,6 +1,11 @@
 #include "arap.h"
 #include "graphics/meshloader.h"
+#include "solver/clustering.h"
+#include "solver/laplacian.h"
+#include "solver/rotationfit.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <set>
 #include <map>
@@ -9,18 +14,81 @@
 using namespace std;
 using namespace Eigen;
 
-ARAP::ARAP() {}
+ARAP::ARAP() :
+    m_pool(),
+    m_proxyMode(false),
+    m_proxySize(DEFAULT_PROXY_SIZE),
+    m_useProxy(false),
+    m_meshOrdering(MeshOrdering::CuthillMcKee),
+    m_orderedFor(MeshOrdering::LoadedOrder),
+    m_reordered(false),
+    m_restEnergy(0.0),
+    m_factorsAnalyzed(false),
+    m_fillOrdering(FillOrdering::MinimumDegree),
+    m_analyzedOrdering(FillOrdering::MinimumDegree),
+    m_multigridBuilt(false),
+    m_globalSolver(GlobalSolver::Factored),
+    m_preconditioner(Preconditioner::JacobiScaling),
+    m_multigridCycle(MultigridCycle::VCycle),
+    m_subspaceMode(false),
+    m_graphMode(false),
+    m_graphNodes(DEFAULT_GRAPH_NODES),
+    m_regionMode(false),
+    m_regionRings(0),
+    m_regionRadius(0.2),
+    m_regionHandle(-1),
+    m_restDiagonal(1.0),
+    m_localSolver(LocalSolver::SVD),
+    m_lazyLocalStep(false),
+    m_lazyTolerance(1e-3),
+    m_meanEdge(1.0),
+    m_lastSkippedRefits(0),
+    m_skippedRefits(0),
+    m_rotationClusters(0),
+    m_clusterMetric(ClusterMetric::RestDistance),
+    m_clusteredCount(0),
+    m_clusteredMetric(ClusterMetric::RestDistance),
+    m_clusterCount(0),
+    m_mailboxFull(false),
+    m_solving(false),
+    m_stopping(false),
+    m_timeBudget(8.0),
+    m_converged(true),
+    m_energy(0.0),
+    m_iterations(0),
+    m_rejectedSteps(0),
+    m_andersonWindow(DEFAULT_ANDERSON_WINDOW),
+    m_accelerated(false),
+    m_resultReady(false)
+{
+    m_shape.setThreadPool(&m_pool);
+    m_cg.setMultigrid(&m_multigrid);
+}
+
+ARAP::~ARAP()
+{
+    stopSolver();
+}
 
 void ARAP::init(Eigen::Vector3f &coeffMin, Eigen::Vector3f &coeffMax)
 {
-    vector<Vector3f> vertices;
-    vector<Vector3i> triangles;
+    stopSolver();
+
+    vector<Vector3f> &vertices  = m_meshVertices;
+    vector<Vector3i> &triangles = m_meshTriangles;
+    vertices.clear();
+    triangles.clear();
 
     // If this doesn't work for you, remember to change your working directory
     if (MeshLoader::loadTriMesh("meshes/cactus.obj", vertices, triangles)) {
         m_shape.init(vertices, triangles);
     }
 
+    m_proxy = ProgressiveMesh();
+    m_orderedFor = MeshOrdering::LoadedOrder;
+    setupSolver();
+    startSolver();
+
     // Students, please don't touch this code: get min and max for viewport stuff
     MatrixX3f all_vertices = MatrixX3f(vertices.size(), 3);
     int i = 0;
@@ -31,14 +99,133 @@ void ARAP::init(Eigen::Vector3f &coeffMin, Eigen::Vector3f &coeffMax)
     coeffMax = all_vertices.colwise().maxCoeff();
 }
 
+// Sets up the solver state for the loaded mesh or its proxy, starting from the rest shape
+void ARAP::setupSolver()
+{
+    m_useProxy = m_proxyMode && (int) m_meshVertices.size() > m_proxySize;
+
+    if (m_useProxy && (!m_proxy.isBuilt() || m_proxy.getTargetVertices() != m_proxySize)) {
+        auto start = chrono::steady_clock::now();
+        m_proxy.build(m_meshVertices, m_meshTriangles, m_proxySize, m_pool);
+        cout << "Simplified " << m_meshVertices.size() << " vertices to a " << m_proxy.getCoarseVertices().size()
+             << "-vertex proxy in " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+    }
+
+    m_reordered = !m_useProxy && m_meshOrdering != MeshOrdering::LoadedOrder;
+
+    if (m_reordered && m_orderedFor != m_meshOrdering) {
+        auto start = chrono::steady_clock::now();
+        if (m_meshOrdering == MeshOrdering::MortonCurve) {
+            VertexOrder::morton(m_meshVertices, m_order);
+        } else {
+            VertexOrder::reverseCuthillMcKee(m_meshVertices.size(), m_meshTriangles, m_order);
+        }
+        m_orderedVertices  = m_meshVertices;
+        m_orderedTriangles = m_meshTriangles;
+        VertexOrder::apply(m_order, m_orderedVertices, m_orderedTriangles, m_rank);
+        m_orderedFor = m_meshOrdering;
+        cout << "Reordered " << m_meshVertices.size() << " vertices by " << (m_meshOrdering == MeshOrdering::MortonCurve ? "Morton code" : "reverse Cuthill-McKee")
+             << " in " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms, mean edge span "
+             << VertexOrder::meanEdgeSpan(m_meshTriangles) << " -> " << VertexOrder::meanEdgeSpan(m_orderedTriangles) << endl;
+    }
+
+    const vector<Vector3f> &vertices  = m_useProxy ? m_proxy.getCoarseVertices() : m_reordered ? m_orderedVertices : m_meshVertices;
+    const vector<Vector3i> &triangles = solverTriangles();
+
+    // Build the cotangent Laplacian once; every later solve reuses it
+    auto start = chrono::steady_clock::now();
+    Laplacian::assemble(vertices, triangles, m_L, m_pool);
+    cout << "Assembled " << m_L.nonZeros() << "-entry Laplacian in "
+         << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+
+    m_rest.resize(vertices.size(), 3);
+    for (unsigned long i = 0; i < vertices.size(); ++i) {
+        m_rest.row(i) = vertices[i].cast<double>();
+    }
+
+    start = chrono::steady_clock::now();
+    m_adjacency.build(m_L, m_rest);
+    cout << "Built one-ring adjacency (" << m_adjacency.slots() << " slots, " << m_adjacency.memoryUsage() / 1024 << " KiB) in "
+         << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+
+    // Symbolic analysis of L happens once per mesh, on the first factored solve
+    m_factorsAnalyzed = false;
+    m_multigridBuilt  = false;
+    m_cg.reset(m_L);
+    m_subspace.reset();
+    m_graph.reset();
+    m_region.reset(vertices.size());
+    m_regionHandle = -1;
+    m_restDiagonal = (m_rest.colwise().maxCoeff() - m_rest.colwise().minCoeff()).norm();
+    m_restEnergy   = 2.0 * (m_rest.transpose() * (m_L * m_rest)).trace();
+    m_meanEdge     = m_adjacency.meanEdgeLength();
+
+    m_quaternions.assign(vertices.size(), Quaterniond::Identity());
+    m_fitReference.resize(0, 3);
+    m_clusteredCount = 0;
+    m_clusterCount   = 0;
+    m_clusterLabels.clear();
+    m_positions = m_rest;
+    m_activeAnchors.clear();
+    m_vertexEnergy.assign(vertices.size(), 0.0);
+    m_converged = true;
+    m_energy    = 0.0;
+    m_anderson.reset(m_positions.size(), m_andersonWindow);
+    m_accelerated = false;
+
+    m_finePositions.resize(m_meshVertices.size(), 3);
+    for (unsigned long i = 0; i < m_meshVertices.size(); ++i) m_finePositions.row(i) = m_meshVertices[i].cast<double>();
+    m_fineAnchors.clear();
+
+    // Show the rest shape on the next frame
+    lock_guard<mutex> lock(m_resultMutex);
+    m_result      = m_meshVertices;
+    m_resultReady = true;
+}
+
+void ARAP::setProxyMode(bool enabled)
+{
+    stopSolver();
+    m_proxyMode = enabled;
+    setupSolver();
+    startSolver();
+}
+
+void ARAP::setMeshOrdering(MeshOrdering ordering)
+{
+    stopSolver();
+    m_meshOrdering = ordering;
+    setupSolver();
+    startSolver();
+}
+
+void ARAP::setProxySize(int vertices)
+{
+    stopSolver();
+    m_proxySize = max(vertices, 4);
+    setupSolver();
+    startSolver();
+}
+
 // Move an anchored vertex, defined by its index, to targetPosition
 void ARAP::move(int vertex, Vector3f targetPosition)
 {
-    std::vector<Eigen::Vector3f> new_vertices = m_shape.getVertices();
     const std::unordered_set<int>& anchors = m_shape.getAnchors();
 
-    // TODO: implement ARAP here
-    new_vertices[vertex] = targetPosition;
+    DragTarget target;
+    target.vertex   = vertex;
+    target.position = targetPosition;
+    target.anchors.assign(anchors.begin(), anchors.end());
+    target.refineOnly = false;
+    sort(target.anchors.begin(), target.anchors.end());
+
+    // Latest wins: whatever the solver has not started on yet is simply replaced
+    {
+        lock_guard<mutex> lock(m_mailboxMutex);
+        m_mailbox     = std::move(target);
+        m_mailboxFull = true;
+    }
+    m_mailboxChanged.notify_all();
 
     // Here are some helpful controls for the application
     //
@@ -52,6 +239,703 @@ void ARAP::move(int vertex, Vector3f targetPosition)
     //   - Left-click an anchored point to move it around
     //
     // - Minus and equal keys (click repeatedly) to change the size of the vertices
+}
+
+void ARAP::refine()
+{
+    if (m_converged) return;
+
+    {
+        lock_guard<mutex> lock(m_mailboxMutex);
+        if (m_mailboxFull || m_solving) return;
+        m_mailbox.vertex     = -1;
+        m_mailbox.refineOnly = true;
+        m_mailboxFull        = true;
+    }
+    m_mailboxChanged.notify_all();
+}
+
+bool ARAP::syncVertices()
+{
+    {
+        lock_guard<mutex> lock(m_resultMutex);
+        if (!m_resultReady) return false;
+        m_display.swap(m_result);
+        m_resultReady = false;
+    }
+
+    m_shape.setVertices(m_display);
+    return true;
+}
+
+void ARAP::waitForSolver()
+{
+    {
+        unique_lock<mutex> lock(m_mailboxMutex);
+        m_mailboxChanged.wait(lock, [this] { return !m_mailboxFull && !m_solving; });
+    }
+    syncVertices();
+}
+
+// ================== Solver Thread
+
+void ARAP::startSolver()
+{
+    m_stopping    = false;
+    m_mailboxFull = false;
+    m_solverThread = thread(&ARAP::solverLoop, this);
+}
+
+void ARAP::stopSolver()
+{
+    if (!m_solverThread.joinable()) return;
+
+    {
+        lock_guard<mutex> lock(m_mailboxMutex);
+        m_stopping = true;
+    }
+    m_mailboxChanged.notify_all();
+    m_solverThread.join();
+}
+
+void ARAP::solverLoop()
+{
+    while (true) {
+        DragTarget target;
+        {
+            unique_lock<mutex> lock(m_mailboxMutex);
+            m_mailboxChanged.wait(lock, [this] { return m_stopping || m_mailboxFull; });
+            if (m_stopping) return;
+
+            target = std::move(m_mailbox);
+            m_mailboxFull = false;
+            m_solving     = true;
+        }
+
+        if (!target.refineOnly) {
+            if (m_useProxy) {
+                target = mapToProxy(target);
+            } else if (m_reordered) {
+                target = mapToSolverOrder(target);
+            }
+        }
+        solve(target);
+        publishPositions();
+
+        {
+            lock_guard<mutex> lock(m_mailboxMutex);
+            m_solving = false;
+        }
+        m_mailboxChanged.notify_all();
+    }
+}
+
+// Moves the proxy vertex the dragged vertex collapsed into by the same displacement, and
+// anchors every proxy vertex that an anchored vertex collapsed into
+ARAP::DragTarget ARAP::mapToProxy(const DragTarget &target)
+{
+    DragTarget coarse;
+    coarse.refineOnly = false;
+    coarse.vertex     = m_proxy.getCoarseVertex(target.vertex);
+
+    const RowVector3d moved = target.position.cast<double>().transpose();
+    coarse.position = (m_positions.row(coarse.vertex) + moved - m_finePositions.row(target.vertex)).transpose().cast<float>();
+
+    for (int a : target.anchors) coarse.anchors.push_back(m_proxy.getCoarseVertex(a));
+    sort(coarse.anchors.begin(), coarse.anchors.end());
+    coarse.anchors.erase(unique(coarse.anchors.begin(), coarse.anchors.end()), coarse.anchors.end());
+
+    m_fineAnchors = target.anchors;
+    m_finePositions.row(target.vertex) = moved;
+    return coarse;
+}
+
+// Renumbers the dragged vertex and the anchors from the loaded order to the solver's
+ARAP::DragTarget ARAP::mapToSolverOrder(const DragTarget &target) const
+{
+    DragTarget ordered = target;
+    ordered.vertex = m_rank[target.vertex];
+    for (int &a : ordered.anchors) a = m_rank[a];
+    sort(ordered.anchors.begin(), ordered.anchors.end());
+    return ordered;
+}
+
+// The triangles of the mesh the solver runs on, numbered like its vertices
+const vector<Vector3i> &ARAP::solverTriangles() const
+{
+    if (m_useProxy) return m_proxy.getCoarseTriangles();
+    return m_reordered ? m_orderedTriangles : m_meshTriangles;
+}
+
+// Hands the solved positions to the render thread, prolonged to full resolution in proxy
+// mode. The copy happens without holding the lock.
+void ARAP::publishPositions()
+{
+    if (m_useProxy) {
+        // Rotations fit to the final positions carry each vertex's offset from the proxy
+        // along; anchors are then put exactly where they were dragged
+        m_proxyRotations.resize(m_positions.rows());
+        fitRotations(m_positions, m_proxyRotations, false);
+        m_proxy.prolong(m_positions, m_proxyRotations, m_staging, m_pool);
+
+        for (int a : m_fineAnchors) m_staging[a] = m_finePositions.row(a).transpose().cast<float>();
+        for (unsigned long i = 0; i < m_staging.size(); ++i) m_finePositions.row(i) = m_staging[i].cast<double>().transpose();
+    } else {
+        // Shape shows the mesh in the loaded order
+        m_staging.resize(m_positions.rows());
+        for (int i = 0; i < m_positions.rows(); ++i) {
+            m_staging[m_reordered ? m_order[i] : i] = m_positions.row(i).transpose().cast<float>();
+        }
+    }
+
+    lock_guard<mutex> lock(m_resultMutex);
+    m_result.swap(m_staging);
+    m_resultReady = true;
+}
+
+// Runs local/global iterations for one drag target until it converges or the time
+// budget runs out, on the solver thread
+void ARAP::solve(const DragTarget &target)
+{
+    const auto deadline = chrono::steady_clock::now() + chrono::duration<double, milli>(m_timeBudget.load());
+
+    if (!target.refineOnly && moveRigidly(target)) return;
+
+    MatrixX3dRow &deformed = m_positions;
+    if (!target.refineOnly) {
+        // The Anderson history describes the map for the previous target, so drop it
+        m_activeAnchors = target.anchors;
+        m_regionHandle  = target.vertex;
+        deformed.row(target.vertex) = target.position.cast<double>().transpose();
+        m_iterations    = 0;
+        m_rejectedSteps = 0;
+        m_skippedRefits = 0;
+        m_accelerated   = false;
+        m_anderson.restart();
+    }
+    if (m_anderson.getWindow() != m_andersonWindow) {
+        m_anderson.reset(deformed.size(), m_andersonWindow);
+        m_accelerated = false;
+    }
+    // New clusters change the energy being minimized, so earlier iterates are no guide
+    const bool clustersChanged = updateClusters();
+    if (clustersChanged) {
+        m_anderson.restart();
+        m_accelerated = false;
+    }
+    const vector<int> &anchorList = m_activeAnchors;
+
+    const int n = deformed.rows();
+
+    MatrixX3dRow anchorTargets(anchorList.size(), 3);
+    for (unsigned long c = 0; c < anchorList.size(); ++c) anchorTargets.row(c) = deformed.row(anchorList[c]);
+
+    if (m_subspaceMode && !anchorList.empty()) {
+        // Weights and reduced matrices are computed once per anchor set; after that the
+        // iterations never touch the vertices, only the final skinning pass does
+        const vector<Vector3i> &triangles = solverTriangles();
+        auto start = chrono::steady_clock::now();
+        if (m_subspace.setAnchors(anchorList, m_rest, triangles, m_L, deformed, m_pool)) {
+            cout << "Precomputed skinning subspace for " << anchorList.size() << " anchors in "
+                 << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+        }
+
+        // Past MAX_ANCHOR_HANDLES anchors some are only held in the least-squares sense, and the
+        // next event reads its targets back from deformed, so put them exactly in place
+        const int iterations = m_subspace.solve(anchorTargets, SUBSPACE_ITERATIONS, SUBSPACE_TOLERANCE);
+        m_subspace.skin(deformed, m_pool);
+        for (unsigned long c = 0; c < anchorList.size(); ++c) deformed.row(anchorList[c]) = anchorTargets.row(c);
+        m_iterations += iterations;
+        m_converged   = iterations < SUBSPACE_ITERATIONS;
+        return;
+    }
+
+    if (m_graphMode && !anchorList.empty()) {
+        if (!m_graph.isBuilt() || m_graph.getTargetNodes() != m_graphNodes) {
+            auto start = chrono::steady_clock::now();
+            m_graph.build(m_rest, m_graphNodes, m_pool);
+            cout << "Sampled a " << m_graph.getNodeCount() << "-node deformation graph in "
+                 << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+        }
+        m_graph.setAnchors(anchorList);
+
+        // The anchors are only held by a penalty on the nodes, so put them exactly in place
+        const int iterations = m_graph.solve(anchorTargets, GRAPH_ITERATIONS, GRAPH_TOLERANCE);
+        m_graph.deform(deformed, m_pool);
+        for (unsigned long c = 0; c < anchorList.size(); ++c) deformed.row(anchorList[c]) = anchorTargets.row(c);
+        m_iterations += iterations;
+        m_converged   = iterations < GRAPH_ITERATIONS;
+        return;
+    }
+
+    if (m_regionMode && m_regionHandle >= 0) {
+        solveRegion(target);
+        return;
+    }
+
+    // Anchored positions only enter the right-hand side through L_fc x_c, whose cost
+    // depends on the anchors' one-rings rather than on the whole mesh
+    const GlobalSolver globalSolver = m_globalSolver;
+    const bool factored = globalSolver == GlobalSolver::Factored || globalSolver == GlobalSolver::Supernodal;
+    const SparseLDLT    *solver           = nullptr;
+    const SupernodalLLT *supernodalSolver = nullptr;
+    MatrixX3dRow constraintRhs;
+
+    if (factored) {
+        if (!m_factorsAnalyzed || m_analyzedOrdering != m_fillOrdering) {
+            m_analyzedOrdering = m_fillOrdering;
+            m_factors.reset(m_L, m_analyzedOrdering);
+            m_factorsAnalyzed = true;
+            cout << "Analyzed the Laplacian with the " << FillReduction::name(m_analyzedOrdering) << " ordering in "
+                 << m_factors.getAnalyzeTime() << " ms: nnz(L) = " << m_factors.getFactor().nonZeros() << ", "
+                 << m_factors.getFactor().flops() / 1e6 << " Mflop per factorization" << endl;
+        }
+
+        // The factor is only recomputed when the anchor set differs from the cached one
+        const int misses = m_factors.getMisses();
+        if (globalSolver == GlobalSolver::Supernodal) {
+            supernodalSolver = &m_factors.getSupernodal(anchorList, m_pool);
+            if (m_factors.getMisses() != misses) {
+                cout << "Refactored " << supernodalSolver->supernodes() << " supernodes for " << anchorList.size() << " anchors in "
+                     << m_factors.getFactorTime() << " ms on " << m_pool.getThreadCount() << " threads (cache hits: "
+                     << m_factors.getHits() << ", misses: " << m_factors.getMisses() << ")" << endl;
+            }
+        } else {
+            solver = &m_factors.get(anchorList);
+            if (m_factors.getMisses() != misses) {
+                cout << "Refactored for " << anchorList.size() << " anchors in " << m_factors.getFactorTime() << " ms (cache hits: "
+                     << m_factors.getHits() << ", updates: " << m_factors.getUpdates() << ", misses: " << m_factors.getMisses() << ")" << endl;
+            }
+        }
+
+        constraintRhs = m_factors.getCoupling() * anchorTargets;
+    } else {
+        if (globalSolver == GlobalSolver::MultigridSolve || m_preconditioner == Preconditioner::MultigridCycles) {
+            if (!m_multigridBuilt) {
+                auto start = chrono::steady_clock::now();
+                m_multigrid.reset(m_L);
+                m_multigridBuilt = true;
+                cout << "Built " << m_multigrid.getLevels() << "-level multigrid hierarchy in "
+                     << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+            }
+            m_multigrid.setCycle(m_multigridCycle);
+            m_multigrid.setAnchors(anchorList);
+        }
+
+        // The PCG solver also provides L_fc x_c to the multigrid backend
+        if (m_cg.getPreconditioner() != m_preconditioner) m_cg.setPreconditioner(m_preconditioner);
+        m_cg.setAnchors(anchorList);
+        m_cg.couplingProduct(deformed, constraintRhs, m_pool);
+    }
+
+    vector<Matrix3d> rotations(n);
+    MatrixX3dRow rhs(n, 3);
+    MatrixX3dRow cgRhs;
+
+    // A new target invalidates the previous energy; a refinement continues from it
+    bool   haveEnergy     = target.refineOnly && !clustersChanged;
+    double previousEnergy = m_energy;
+    bool   converged      = false;
+
+    do {
+        // Local step: best-fit rotation per vertex, then one sweep for the right-hand side
+        // of the global step and the current energy
+        fitRotations(deformed, rotations);
+        double currentEnergy = buildRhs(deformed, rotations, rhs);
+
+        // Safeguard: an accelerated iterate must not raise the energy, otherwise take the
+        // plain step instead, which never does, and start the history over
+        if (m_accelerated && haveEnergy && currentEnergy > previousEnergy) {
+            deformed = m_plainStep;
+            m_anderson.restart();
+            ++m_rejectedSteps;
+
+            fitRotations(deformed, rotations);
+            currentEnergy = buildRhs(deformed, rotations, rhs);
+        }
+
+        converged      = haveEnergy && previousEnergy - currentEnergy <= ENERGY_TOLERANCE * previousEnergy;
+        previousEnergy = currentEnergy;
+        haveEnergy     = true;
+
+        // Global step: solve L p' = b with anchored rows held at their targets
+        rhs -= constraintRhs;
+        for (unsigned long c = 0; c < anchorList.size(); ++c) rhs.row(anchorList[c]) = anchorTargets.row(c);
+
+        if (supernodalSolver) {
+            supernodalSolver->solveInPlace(rhs);
+        } else if (factored) {
+            solver->solveInPlace(rhs);
+        } else {
+            // Warm start from the current iterate, which the previous global step produced
+            cgRhs.swap(rhs);
+            rhs = deformed;
+            if (globalSolver == GlobalSolver::MultigridSolve) {
+                m_multigrid.solve(cgRhs, rhs, m_pool);
+            } else {
+                m_cg.solve(cgRhs, rhs, m_pool);
+            }
+        }
+        ++m_iterations;
+
+        // Every image keeps the anchored rows at their targets, so their combinations do too.
+        // The converged result is left unaccelerated, since nothing would check it.
+        m_accelerated = !converged && m_anderson.getWindow() > 0;
+        if (m_accelerated) {
+            m_plainStep = rhs;
+            m_anderson.accelerate(Map<const VectorXd>(rhs.data(), rhs.size()), Map<VectorXd>(deformed.data(), deformed.size()));
+        } else {
+            deformed.swap(rhs);
+        }
+    } while (!converged && chrono::steady_clock::now() < deadline);
+
+    m_energy    = previousEnergy;
+    m_converged = converged;
+
+    if (converged && m_lazyLocalStep && m_clusterCount == 0) {
+        cout << "Converged in " << m_iterations << " iterations; the lazy local step kept " << m_lastSkippedRefits
+             << " of " << n << " rotations in the last one and " << m_skippedRefits << " since the drag event ("
+             << m_skippedRefits / max(m_iterations.load(), 1) << " per iteration)" << endl;
+    }
+}
+
+// Regroups the vertices if the requested clustering changed since the last solve, and
+// returns whether it did
+bool ARAP::updateClusters()
+{
+    const int           requested = m_rotationClusters;
+    const ClusterMetric metric    = m_clusterMetric;
+    if (requested == m_clusteredCount && (requested == 0 || metric == m_clusteredMetric)) return false;
+
+    m_clusteredCount  = requested;
+    m_clusteredMetric = metric;
+    if (requested == 0 || requested >= m_rest.rows()) {
+        m_clusterCount = 0;
+        m_clusterLabels.clear();
+        return true;
+    }
+
+    auto start = chrono::steady_clock::now();
+    const MatrixXd points = m_rest;
+    if (metric == ClusterMetric::GeodesicDistance) {
+        m_clusterCount = Clustering::geodesicKMeans(m_L, points, requested, m_clusterLabels);
+    } else {
+        m_clusterCount = Clustering::kMeans(points, requested, m_clusterLabels, m_pool);
+    }
+    m_fitReference.resize(0, 3);
+    m_clusterCovariances.resize(m_clusterCount);
+    m_clusterQuaternions.assign(m_clusterCount, Quaterniond::Identity());
+
+    cout << "Grouped " << m_rest.rows() << " vertices into " << m_clusterCount << " rotation clusters by "
+         << (metric == ClusterMetric::GeodesicDistance ? "geodesic" : "rest-space") << " distance in "
+         << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+    return true;
+}
+
+// One anchor, or two with the dragged one keeping its distance to the other, can be met
+// exactly by a rigid motion. When the current shape is itself a rigid copy of the rest
+// shape (zero energy), that motion is the ARAP solution, so it is applied directly
+// instead of iterating; returns whether it was. The reduced modes keep their own state
+// and always solve.
+bool ARAP::moveRigidly(const DragTarget &target)
+{
+    const vector<int> &anchors = target.anchors;
+    if (anchors.empty() || anchors.size() > 2 || !binary_search(anchors.begin(), anchors.end(), target.vertex)) return false;
+    if (m_subspaceMode || m_graphMode) return false;
+    if (!m_converged || m_energy > ENERGY_TOLERANCE * m_restEnergy) return false;
+
+    MatrixX3dRow &deformed = m_positions;
+    const RowVector3d from = deformed.row(target.vertex);
+    const RowVector3d to   = target.position.cast<double>().transpose();
+
+    // p' = R (p - pivot) + pivot + shift
+    Matrix3d    rotation = Matrix3d::Identity();
+    RowVector3d pivot    = from;
+    RowVector3d shift    = to - from;
+    if (anchors.size() == 2) {
+        pivot = deformed.row(anchors[0] == target.vertex ? anchors[1] : anchors[0]);
+        shift.setZero();
+
+        const Vector3d before = (from - pivot).transpose();
+        const Vector3d after  = (to - pivot).transpose();
+        if (abs(after.norm() - before.norm()) > RIGID_TOLERANCE * before.norm()) return false;
+        rotation = Quaterniond::FromTwoVectors(before, after).toRotationMatrix();
+    }
+
+    const RowVector3d offset = pivot + shift;
+    const Matrix3d    rotationT = rotation.transpose();
+    m_pool.parallelFor(0, deformed.rows(), [&](int begin, int end) {
+        auto rows = deformed.middleRows(begin, end - begin);
+        rows = ((rows.rowwise() - pivot) * rotationT).rowwise() + offset;
+    }, 1024);
+    deformed.row(target.vertex) = to;
+
+    // The warm-started rotations turn along with the shape
+    if (anchors.size() == 2) {
+        const Quaterniond turn(rotation);
+        for (Quaterniond &q : m_quaternions) q = turn * q;
+    }
+
+    m_activeAnchors = anchors;
+    m_regionHandle  = target.vertex;
+    m_iterations    = 0;
+    m_rejectedSteps = 0;
+    m_accelerated   = false;
+    m_anderson.restart();
+    return true;
+}
+
+// Plain local/global iterations restricted to the region around the dragged handle, with
+// its held ring and the anchors inside it at their current positions. The local step
+// uses batched SVDs and no clustering, and there is no Anderson acceleration, since the
+// iterate is not the whole mesh.
+void ARAP::solveRegion(const DragTarget &target)
+{
+    auto start = chrono::steady_clock::now();
+    const auto deadline = start + chrono::duration<double, milli>(m_timeBudget.load());
+
+    MatrixX3dRow &deformed = m_positions;
+    const int rings = m_regionRings;
+    if (m_region.select(m_L, m_rest, m_regionHandle, m_activeAnchors, rings, m_regionRadius * m_restDiagonal)) {
+        cout << "Factored a " << m_region.getFreeCount() << "-vertex region in "
+             << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms (cache hits: "
+             << m_region.getHits() << ", misses: " << m_region.getMisses() << ")" << endl;
+    }
+
+    const vector<int>          &vertices  = m_region.getVertices();
+    const SparseMatrix<double> &L         = m_region.getLaplacian();
+    const SparseLDLT           &solver    = m_region.getFactor();
+    const int                   size      = vertices.size();
+    const int                   freeCount = m_region.getFreeCount();
+
+    MatrixX3dRow held(size - freeCount, 3);
+    for (int c = 0; c < size - freeCount; ++c) held.row(c) = deformed.row(vertices[freeCount + c]);
+    const MatrixX3dRow constraintRhs = m_region.getCoupling() * held;
+
+    vector<Matrix3d> rotations(size);
+    vector<double>   vertexEnergy(freeCount);
+    MatrixX3dRow     rhs(size, 3);
+
+    bool   haveEnergy     = target.refineOnly;
+    double previousEnergy = m_energy;
+    bool   converged      = false;
+
+    do {
+        // Held vertices need rotations too, for the right-hand side of their free neighbours
+        m_pool.parallelFor(0, size, [&](int begin, int end) {
+            for (int a = begin; a < end; ++a) rotations[a] = covariance(deformed, vertices[a]);
+            RotationFit::fit(rotations.data() + begin, rotations.data() + begin, end - begin);
+        }, 64);
+
+        m_pool.parallelFor(0, freeCount, [&](int begin, int end) {
+            for (int a = begin; a < end; ++a) {
+                double   e = 0;
+                Vector3d b = Vector3d::Zero();
+                for (SparseMatrix<double>::InnerIterator it(L, a); it; ++it) {
+                    const int j = it.index();
+                    if (j == a) continue;
+                    const Vector3d restEdge     = (m_rest.row(vertices[a]) - m_rest.row(vertices[j])).transpose();
+                    const Vector3d deformedEdge = (deformed.row(vertices[a]) - deformed.row(vertices[j])).transpose();
+                    e -= it.value() * (deformedEdge - rotations[a] * restEdge).squaredNorm();
+                    b -= 0.5 * it.value() * (rotations[a] + rotations[j]) * restEdge;
+                }
+                vertexEnergy[a] = e;
+                rhs.row(a)      = b.transpose() - constraintRhs.row(a);
+            }
+        });
+        rhs.bottomRows(size - freeCount) = held;
+
+        double currentEnergy = 0;
+        for (double e : vertexEnergy) currentEnergy += e;
+        converged      = haveEnergy && previousEnergy - currentEnergy <= ENERGY_TOLERANCE * previousEnergy;
+        previousEnergy = currentEnergy;
+        haveEnergy     = true;
+
+        solver.solveInPlace(rhs);
+        for (int a = 0; a < freeCount; ++a) deformed.row(vertices[a]) = rhs.row(a);
+        ++m_iterations;
+    } while (!converged && chrono::steady_clock::now() < deadline);
+
+    m_energy    = previousEnergy;
+    m_converged = converged;
+}
+
+// ================== Local/Global Steps
+
+// S_i = sum_j w_ij (p_i - p_j) (p'_i - p'_j)^T
+Matrix3d ARAP::covariance(const MatrixX3dRow &deformed, int i) const
+{
+    Matrix3d covariance = Matrix3d::Zero();
+    for (const Adjacency::Neighbor &neighbor : m_adjacency.neighbors(i)) {
+        const Vector3d deformedEdge = (deformed.row(i) - deformed.row(neighbor.vertex)).transpose();
+        covariance += neighbor.weight * Adjacency::restEdge(neighbor) * deformedEdge.transpose();
+    }
+    return covariance;
+}
+
+// R_i = argmin sum_j w_ij |(p'_i - p'_j) - R_i (p_i - p_j)|^2, from the SVD of the covariance S_i.
+// Fits outside the local/global iterations pass allowLazy = false, so they neither count as
+// skipped refits nor move the lazy step's reference positions.
+void ARAP::fitRotations(const MatrixX3dRow &deformed, vector<Matrix3d> &rotations, bool allowLazy)
+{
+    if (m_clusterCount > 0) {
+        fitClusterRotations(deformed, rotations);
+        return;
+    }
+    if (m_lazyLocalStep && allowLazy) {
+        fitRotationsLazily(deformed, rotations);
+        return;
+    }
+    // References kept while the lazy step is off would be stale when it comes back on
+    if (!m_lazyLocalStep) m_fitReference.resize(0, 3);
+
+    m_pool.parallelFor(0, m_adjacency.vertices(), [&](int begin, int end) {
+        Matrix3d *covariances = rotations.data() + begin;
+        for (int i = begin; i < end; ++i) covariances[i - begin] = covariance(deformed, i);
+
+        // Rotations overwrite their covariances in place, chunk by chunk
+        switch (m_localSolver) {
+        case LocalSolver::SVD: {
+            // Batched across SIMD lanes, reflections already corrected
+            RotationFit::fit(covariances, covariances, end - begin);
+            break;
+        }
+        case LocalSolver::WarmQuaternion: {
+            RotationFit::fitWarmStarted(covariances, m_quaternions.data() + begin, covariances, end - begin, QUATERNION_ITERATIONS);
+            break;
+        }
+        }
+    }, 64);
+}
+
+// Refits only the rotations whose one-ring moved. A vertex counts as moved once it is more
+// than the tolerance away from its reference position, which is then reset to where it is;
+// a moved vertex marks itself and its neighbours dirty. Every rotation kept was therefore
+// fit to a one-ring within twice the tolerance of the current one.
+void ARAP::fitRotationsLazily(const MatrixX3dRow &deformed, vector<Matrix3d> &rotations)
+{
+    const int n = m_adjacency.vertices();
+
+    if (m_fitReference.rows() != n) {
+        m_fitReference = deformed;
+        m_fitRotations.resize(n);
+        m_moved.assign(n, 1);
+        m_dirty.resize(n);
+    } else {
+        const double tolerance = m_lazyTolerance * m_meanEdge;
+        m_pool.parallelFor(0, n, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                m_moved[i] = (deformed.row(i) - m_fitReference.row(i)).squaredNorm() > tolerance * tolerance;
+            }
+        });
+    }
+
+    m_pool.parallelFor(0, n, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            char dirty = m_moved[i];
+            for (const Adjacency::Neighbor &neighbor : m_adjacency.neighbors(i)) dirty |= m_moved[neighbor.vertex];
+            m_dirty[i] = dirty;
+        }
+    });
+
+    atomic<int> skipped(0);
+    m_pool.parallelFor(0, n, [&](int begin, int end) {
+        // Dirty vertices are packed so the fit still runs in full batches
+        vector<int>         indices;
+        vector<Matrix3d>    covariances;
+        vector<Quaterniond> quaternions;
+        for (int i = begin; i < end; ++i) {
+            if (!m_dirty[i]) continue;
+            indices.push_back(i);
+            covariances.push_back(covariance(deformed, i));
+        }
+        const int count = indices.size();
+
+        switch (m_localSolver) {
+        case LocalSolver::SVD: {
+            RotationFit::fit(covariances.data(), covariances.data(), count);
+            break;
+        }
+        case LocalSolver::WarmQuaternion: {
+            for (int i : indices) quaternions.push_back(m_quaternions[i]);
+            RotationFit::fitWarmStarted(covariances.data(), quaternions.data(), covariances.data(), count, QUATERNION_ITERATIONS);
+            for (int k = 0; k < count; ++k) m_quaternions[indices[k]] = quaternions[k];
+            break;
+        }
+        }
+
+        for (int k = 0; k < count; ++k) m_fitRotations[indices[k]] = covariances[k];
+        for (int i = begin; i < end; ++i) {
+            rotations[i] = m_fitRotations[i];
+            if (m_moved[i]) m_fitReference.row(i) = deformed.row(i);
+        }
+        skipped += (end - begin) - count;
+    }, 64);
+
+    m_lastSkippedRefits = skipped.load();
+    m_skippedRefits    += skipped.load();
+}
+
+// The rotation shared by a cluster minimizes the summed energy of its vertices, so it is fit
+// to the sum of their covariances; that is one fit per cluster instead of per vertex
+void ARAP::fitClusterRotations(const MatrixX3dRow &deformed, vector<Matrix3d> &rotations)
+{
+    const int n = m_adjacency.vertices();
+    m_pool.parallelFor(0, n, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) rotations[i] = covariance(deformed, i);
+    }, 64);
+
+    // Summed in vertex order, so the result does not depend on the thread count
+    for (Matrix3d &S : m_clusterCovariances) S.setZero();
+    for (int i = 0; i < n; ++i) m_clusterCovariances[m_clusterLabels[i]] += rotations[i];
+
+    Matrix3d *clusters = m_clusterCovariances.data();
+    switch (m_localSolver) {
+    case LocalSolver::SVD: {
+        RotationFit::fit(clusters, clusters, m_clusterCount);
+        break;
+    }
+    case LocalSolver::WarmQuaternion: {
+        RotationFit::fitWarmStarted(clusters, m_clusterQuaternions.data(), clusters, m_clusterCount, QUATERNION_ITERATIONS);
+        break;
+    }
+    }
+
+    m_pool.parallelFor(0, n, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) rotations[i] = m_clusterCovariances[m_clusterLabels[i]];
+    });
+}
+
+// b_i = sum_j w_ij / 2 (R_i + R_j) (p_i - p_j), fused with the energy
+//
+// E = sum_i sum_j w_ij |(p'_i - p'_j) - R_i (p_i - p_j)|^2
+//
+// in the same sweep over the adjacency, which would otherwise be read a third time per
+// iteration. Returns E, summed in a fixed order so the convergence test does not depend
+// on how the loop was split across threads.
+double ARAP::buildRhs(const MatrixX3dRow &deformed, const vector<Matrix3d> &rotations, MatrixX3dRow &rhs)
+{
+    m_pool.parallelFor(0, m_adjacency.vertices(), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const Matrix3d &rotation = rotations[i];
+            const RowVector3d position = deformed.row(i);
+
+            double   e = 0;
+            Vector3d b = Vector3d::Zero();
+            for (const Adjacency::Neighbor &neighbor : m_adjacency.neighbors(i)) {
+                const Map<const Vector3d> restEdge = Adjacency::restEdge(neighbor);
+                const Vector3d deformedEdge = (position - deformed.row(neighbor.vertex)).transpose();
+                const Vector3d rotatedEdge  = rotation * restEdge;
+
+                e += neighbor.weight * (deformedEdge - rotatedEdge).squaredNorm();
+                b += 0.5 * neighbor.weight * (rotatedEdge + rotations[neighbor.vertex] * restEdge);
+            }
+            m_vertexEnergy[i] = e;
+            rhs.row(i)        = b.transpose();
+        }
+    });
 
-    m_shape.setVertices(new_vertices);
+    double total = 0;
+    for (double e : m_vertexEnergy) total += e;
+    return total;
 }
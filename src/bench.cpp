@@ -0,0 +1,637 @@
+#include "graphics/meshloader.h"
+#include "solver/adjacency.h"
+#include "solver/anderson.h"
+#include "solver/factorcache.h"
+#include "solver/laplacian.h"
+#include "solver/multigrid.h"
+#include "solver/pcgsolver.h"
+#include "solver/rotationfit.h"
+#include "solver/threadpool.h"
+#include "solver/vertexorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace Eigen;
+
+// Headless benchmark for the solver backends, printing the figures quoted for them on the
+// meshes given on the command line (bunny and peter by default, run from the repository
+// root). Every figure is wall-clock time on whatever machine runs it; nothing here reads
+// hardware performance counters.
+//
+//   arap-bench [mesh.obj ...]
+
+struct Mesh
+{
+    string           name;
+    vector<Vector3f> vertices;
+    vector<Vector3i> triangles;
+};
+
+// The mesh's Laplacian and one-ring adjacency, as ARAP::init sets them up, and the drag the
+// iteration and ordering measurements use: vertex 0 and n / 2 anchored, vertex 0 moved by
+// 0.3 of the bounding box diagonal
+struct System
+{
+    SparseMatrix<double> L;
+    Adjacency            adjacency;
+    MatrixX3dRow         rest;
+    vector<double>       vertexEnergy;
+
+    vector<int>  anchors;
+    MatrixX3dRow anchorTargets;
+
+    // Local step as ARAP::fitRotations runs it, per-vertex SVDs or quaternions warm-started
+    // from the previous iteration; fitMs accumulates the time spent fitting rotations
+    bool                warmQuaternions;
+    vector<Quaterniond> quaternions;
+    double              fitMs;
+
+    // Lazy local step as in ARAP::fitRotationsLazily, off at a tolerance of 0, otherwise a
+    // fraction of the mean rest edge length. The references persist across a drag's iterations.
+    double           lazyTolerance;
+    double           meanEdge;
+    MatrixX3dRow     fitReference;
+    vector<Matrix3d> fitRotations;
+    vector<char>     moved;
+    vector<char>     dirty;
+    long             skippedRefits;
+
+    System(const Mesh &mesh, ThreadPool &pool) :
+        warmQuaternions(false),
+        fitMs(0.0),
+        lazyTolerance(0.0),
+        skippedRefits(0)
+    {
+        const int n = mesh.vertices.size();
+        Laplacian::assemble(mesh.vertices, mesh.triangles, L, pool);
+        rest.resize(n, 3);
+        for (int i = 0; i < n; ++i) rest.row(i) = mesh.vertices[i].cast<double>().transpose();
+        adjacency.build(L, rest);
+        meanEdge = adjacency.meanEdgeLength();
+        vertexEnergy.resize(n);
+
+        const double diagonal = (rest.colwise().maxCoeff() - rest.colwise().minCoeff()).norm();
+        anchors = {0, n / 2};
+        anchorTargets.resize(2, 3);
+        anchorTargets.row(0) = rest.row(0) + 0.3 * diagonal * RowVector3d(0.6, 0.8, 0.0);
+        anchorTargets.row(1) = rest.row(n / 2);
+    }
+};
+
+// Outcome of one drag
+struct Run
+{
+    int    iterations;
+    int    rejected;
+    long   skippedRefits;
+    double fitMs;
+    double energy;
+    double ms;
+};
+
+// Mean wall-clock milliseconds of repeats calls of run, after one untimed call to warm up
+template<typename Function>
+static double timeMs(int repeats, Function run)
+{
+    run();
+    const auto start = chrono::steady_clock::now();
+    for (int r = 0; r < repeats; ++r) run();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeats;
+}
+
+// ================== Block Solves
+
+// Three single-column solves against one block solve for x, y and z, with two anchors
+static void benchBlockSolve(const Mesh &mesh, ThreadPool &pool)
+{
+    const int REPEATS = 200;
+
+    SparseMatrix<double> L;
+    Laplacian::assemble(mesh.vertices, mesh.triangles, L, pool);
+    const int n = L.rows();
+
+    FactorCache cache;
+    cache.reset(L);
+    const SparseLDLT &factor = cache.get({0, n / 2});
+
+    const MatrixX3dRow B = MatrixX3dRow::Random(n, 3);
+    MatrixX3dRow columns(n, 3), block(n, 3);
+
+    const double columnMs = timeMs(REPEATS, [&]() {
+        for (int c = 0; c < 3; ++c) {
+            VectorXd x = B.col(c);
+            factor.solveInPlace(x);
+            columns.col(c) = x;
+        }
+    });
+    const double blockMs = timeMs(REPEATS, [&]() {
+        block = B;
+        factor.solveInPlace(block);
+    });
+
+    cout << "  " << setw(14) << left << mesh.name << right << " n " << setw(7) << n << "  nnz(L) " << setw(8) << factor.nonZeros()
+         << "  3 solves " << setw(6) << columnMs << " ms  block " << setw(6) << blockMs << " ms  results "
+         << (columns == block ? "bit-identical" : "differ") << endl;
+}
+
+// ================== Local/Global Iterations
+
+// ARAP's relative energy decrease at which a drag has converged
+const double ENERGY_TOLERANCE = 1e-5;
+const int    MAX_ITERATIONS   = 20000;
+
+// ARAP::QUATERNION_ITERATIONS
+const int QUATERNION_ITERATIONS = 3;
+
+// ARAP::covariance
+static Matrix3d covariance(const System &system, const MatrixX3dRow &deformed, int i)
+{
+    Matrix3d covariance = Matrix3d::Zero();
+    for (const Adjacency::Neighbor &neighbor : system.adjacency.neighbors(i)) {
+        const Vector3d deformedEdge = (deformed.row(i) - deformed.row(neighbor.vertex)).transpose();
+        covariance += neighbor.weight * Adjacency::restEdge(neighbor) * deformedEdge.transpose();
+    }
+    return covariance;
+}
+
+// ARAP::fitRotationsLazily with per-vertex SVDs
+static void fitRotationsLazily(System &system, const MatrixX3dRow &deformed, vector<Matrix3d> &rotations, ThreadPool &pool)
+{
+    const int n = system.adjacency.vertices();
+
+    if (system.fitReference.rows() != n) {
+        system.fitReference = deformed;
+        system.fitRotations.resize(n);
+        system.moved.assign(n, 1);
+        system.dirty.resize(n);
+    } else {
+        const double tolerance = system.lazyTolerance * system.meanEdge;
+        for (int i = 0; i < n; ++i) system.moved[i] = (deformed.row(i) - system.fitReference.row(i)).squaredNorm() > tolerance * tolerance;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        char dirty = system.moved[i];
+        for (const Adjacency::Neighbor &neighbor : system.adjacency.neighbors(i)) dirty |= system.moved[neighbor.vertex];
+        system.dirty[i] = dirty;
+    }
+
+    pool.parallelFor(0, n, [&](int begin, int end) {
+        vector<int>      indices;
+        vector<Matrix3d> covariances;
+        for (int i = begin; i < end; ++i) {
+            if (!system.dirty[i]) continue;
+            indices.push_back(i);
+            covariances.push_back(covariance(system, deformed, i));
+        }
+        const int count = indices.size();
+        RotationFit::fit(covariances.data(), covariances.data(), count);
+
+        for (int k = 0; k < count; ++k) system.fitRotations[indices[k]] = covariances[k];
+        for (int i = begin; i < end; ++i) {
+            rotations[i] = system.fitRotations[i];
+            if (system.moved[i]) system.fitReference.row(i) = deformed.row(i);
+        }
+    }, 64);
+
+    for (int i = 0; i < n; ++i) system.skippedRefits += !system.dirty[i];
+}
+
+// ARAP::fitRotations, then ARAP::buildRhs; returns the energy
+static double localStep(System &system, const MatrixX3dRow &deformed, vector<Matrix3d> &rotations, MatrixX3dRow &rhs, ThreadPool &pool)
+{
+    const Adjacency &adjacency = system.adjacency;
+
+    const auto fitStart = chrono::steady_clock::now();
+    if (system.lazyTolerance > 0) {
+        fitRotationsLazily(system, deformed, rotations, pool);
+    } else {
+        pool.parallelFor(0, adjacency.vertices(), [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) rotations[i] = covariance(system, deformed, i);
+            if (system.warmQuaternions) {
+                RotationFit::fitWarmStarted(rotations.data() + begin, system.quaternions.data() + begin, rotations.data() + begin, end - begin,
+                                            QUATERNION_ITERATIONS);
+            } else {
+                RotationFit::fit(rotations.data() + begin, rotations.data() + begin, end - begin);
+            }
+        }, 64);
+    }
+    system.fitMs += chrono::duration<double, milli>(chrono::steady_clock::now() - fitStart).count();
+
+    pool.parallelFor(0, adjacency.vertices(), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const Matrix3d &rotation = rotations[i];
+            double   e = 0;
+            Vector3d b = Vector3d::Zero();
+            for (const Adjacency::Neighbor &neighbor : adjacency.neighbors(i)) {
+                const Map<const Vector3d> restEdge = Adjacency::restEdge(neighbor);
+                const Vector3d deformedEdge = (deformed.row(i) - deformed.row(neighbor.vertex)).transpose();
+                const Vector3d rotatedEdge  = rotation * restEdge;
+
+                e += neighbor.weight * (deformedEdge - rotatedEdge).squaredNorm();
+                b += 0.5 * neighbor.weight * (rotatedEdge + rotations[neighbor.vertex] * restEdge);
+            }
+            system.vertexEnergy[i] = e;
+            rhs.row(i)             = b.transpose();
+        }
+    });
+
+    double total = 0;
+    for (double e : system.vertexEnergy) total += e;
+    return total;
+}
+
+// ARAP::solve with the LDL^T global step and the same safeguard on accelerated iterates.
+// Runs from the rest pose until the energy decrease is below ENERGY_TOLERANCE or, given a
+// positive stopEnergy, until the energy is down to that instead.
+static Run drag(System &system, int window, double stopEnergy, ThreadPool &pool)
+{
+    const int n = system.rest.rows();
+
+    FactorCache cache;
+    cache.reset(system.L);
+    const SparseLDLT &factor = cache.get(system.anchors);
+    const MatrixX3dRow constraintRhs = cache.getCoupling() * system.anchorTargets;
+
+    MatrixX3dRow deformed = system.rest;
+    for (unsigned long c = 0; c < system.anchors.size(); ++c) deformed.row(system.anchors[c]) = system.anchorTargets.row(c);
+
+    Anderson anderson;
+    anderson.reset(deformed.size(), window);
+
+    vector<Matrix3d> rotations(n);
+    MatrixX3dRow rhs(n, 3);
+    MatrixX3dRow plainStep;
+
+    system.quaternions.assign(n, Quaterniond::Identity());
+    system.fitMs = 0.0;
+    system.fitReference.resize(0, 3);
+    system.skippedRefits = 0;
+
+    Run    run            = {0, 0, 0, 0.0, 0.0, 0.0};
+    bool   accelerated    = false;
+    bool   haveEnergy     = false;
+    bool   converged      = false;
+    double previousEnergy = 0;
+
+    const auto start = chrono::steady_clock::now();
+    while (!converged && run.iterations < MAX_ITERATIONS) {
+        double energy = localStep(system, deformed, rotations, rhs, pool);
+        if (accelerated && haveEnergy && energy > previousEnergy) {
+            deformed = plainStep;
+            anderson.restart();
+            ++run.rejected;
+            energy = localStep(system, deformed, rotations, rhs, pool);
+        }
+
+        converged      = stopEnergy > 0 ? energy <= stopEnergy : haveEnergy && previousEnergy - energy <= ENERGY_TOLERANCE * previousEnergy;
+        previousEnergy = energy;
+        haveEnergy     = true;
+
+        rhs -= constraintRhs;
+        for (unsigned long c = 0; c < system.anchors.size(); ++c) rhs.row(system.anchors[c]) = system.anchorTargets.row(c);
+        factor.solveInPlace(rhs);
+        ++run.iterations;
+
+        accelerated = !converged && window > 0;
+        if (accelerated) {
+            plainStep = rhs;
+            anderson.accelerate(Map<const VectorXd>(rhs.data(), rhs.size()), Map<VectorXd>(deformed.data(), deformed.size()));
+        } else {
+            deformed.swap(rhs);
+        }
+    }
+    run.ms            = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    run.energy        = previousEnergy;
+    run.skippedRefits = system.skippedRefits;
+    run.fitMs         = system.fitMs;
+    return run;
+}
+
+// Plain alternation to convergence, then each Anderson window until it reaches that energy
+static void benchAnderson(const Mesh &mesh, ThreadPool &pool)
+{
+    System system(mesh, pool);
+
+    const Run plain = drag(system, 0, 0.0, pool);
+    cout << "  " << setw(14) << left << mesh.name << right << " plain  " << setw(5) << plain.iterations << " it "
+         << setw(8) << plain.ms << " ms  energy " << scientific << plain.energy << fixed << endl;
+
+    for (int window : {2, 5, 10}) {
+        const Run accelerated = drag(system, window, plain.energy, pool);
+        cout << "  " << setw(14) << "" << " AA(" << setw(2) << window << ") " << setw(5) << accelerated.iterations << " it "
+             << setw(8) << accelerated.ms << " ms  rejected " << accelerated.rejected
+             << (accelerated.energy <= plain.energy ? "" : "  (iteration cap, above the plain energy)") << endl;
+    }
+}
+
+// Plain alternation on the shared drag to convergence, fitting the rotations with per-vertex
+// SVDs and with warm-started quaternions
+static void benchRotationFit(const Mesh &mesh, ThreadPool &pool)
+{
+    System system(mesh, pool);
+
+    for (bool warmQuaternions : {false, true}) {
+        system.warmQuaternions = warmQuaternions;
+        const Run run = drag(system, 0, 0.0, pool);
+        cout << "  " << setw(14) << left << (warmQuaternions ? "" : mesh.name) << setw(11) << (warmQuaternions ? "quaternion" : "SVD") << right
+             << setw(5) << run.iterations << " it " << setw(8) << run.ms << " ms  fit " << setw(6) << run.fitMs / run.iterations
+             << " ms per iteration  energy " << scientific << setprecision(6) << run.energy << fixed << setprecision(2) << endl;
+    }
+}
+
+// ================== Lazy Local Step
+
+// A partial deformation: vertex 0 moves by 0.1 of the bounding box diagonal while every
+// vertex more than 0.3 of the diagonal away from it stays anchored, as when waving one limb
+static void anchorPartialDrag(System &system)
+{
+    const int n = system.rest.rows();
+    const double diagonal = (system.rest.colwise().maxCoeff() - system.rest.colwise().minCoeff()).norm();
+
+    system.anchors = {0};
+    for (int i = 1; i < n; ++i) {
+        if ((system.rest.row(i) - system.rest.row(0)).norm() > 0.3 * diagonal) system.anchors.push_back(i);
+    }
+
+    system.anchorTargets.resize(system.anchors.size(), 3);
+    for (unsigned long c = 0; c < system.anchors.size(); ++c) system.anchorTargets.row(c) = system.rest.row(system.anchors[c]);
+    system.anchorTargets.row(0) += 0.1 * diagonal * RowVector3d(0.6, 0.8, 0.0);
+}
+
+// The partial drag to convergence with every rotation refit, and with the lazy local step at
+// ARAP's default tolerance, both with Anderson mixing as the viewer runs them
+static void benchLazy(const Mesh &mesh, ThreadPool &pool)
+{
+    const double LAZY_TOLERANCE  = 1e-3;
+    const int    ANDERSON_WINDOW = 5;
+
+    System system(mesh, pool);
+    anchorPartialDrag(system);
+    const int n = system.rest.rows();
+
+    for (double tolerance : {0.0, LAZY_TOLERANCE}) {
+        system.lazyTolerance = tolerance;
+        const Run run = drag(system, ANDERSON_WINDOW, 0.0, pool);
+        cout << "  " << setw(14) << left << (tolerance == 0 ? mesh.name : "") << setw(6) << (tolerance == 0 ? "eager" : "lazy") << right
+             << " free " << setw(6) << n - int(system.anchors.size()) << " of " << setw(6) << n << "  " << setw(4) << run.iterations
+             << " it " << setw(8) << run.ms << " ms  skipped refits " << setw(8) << double(run.skippedRefits) / run.iterations
+             << " per iteration  energy " << scientific << setprecision(6) << run.energy << fixed << setprecision(2) << endl;
+    }
+}
+
+// ================== Multigrid Scaling
+
+// 1-to-4 midpoint subdivision, so each step has four times the triangles of the last
+static Mesh subdivide(const Mesh &mesh)
+{
+    Mesh fine;
+    fine.name     = mesh.name;
+    fine.vertices = mesh.vertices;
+
+    map<pair<int, int>, int> midpoints;
+    auto midpoint = [&](int a, int b) {
+        const pair<int, int> edge(min(a, b), max(a, b));
+        const auto found = midpoints.find(edge);
+        if (found != midpoints.end()) return found->second;
+        fine.vertices.push_back(0.5f * (mesh.vertices[a] + mesh.vertices[b]));
+        return midpoints[edge] = fine.vertices.size() - 1;
+    };
+
+    for (const Vector3i &t : mesh.triangles) {
+        const int ab = midpoint(t[0], t[1]);
+        const int bc = midpoint(t[1], t[2]);
+        const int ca = midpoint(t[2], t[0]);
+        fine.triangles.emplace_back(t[0], ab, ca);
+        fine.triangles.emplace_back(t[1], bc, ab);
+        fine.triangles.emplace_back(t[2], ca, bc);
+        fine.triangles.emplace_back(ab, bc, ca);
+    }
+    return fine;
+}
+
+// One global solve to 1e-6 on the mesh subdivided 0 to 3 times, renumbered by reverse
+// Cuthill-McKee as ARAP does by default. The lowest and highest 20 vertices are anchored,
+// the highest ones moved sideways by 5% of the bounding box diagonal.
+static void benchMultigrid(const Mesh &mesh, ThreadPool &pool)
+{
+    const int SUBDIVISIONS = 3;
+    const int ANCHORS      = 20;
+
+    Mesh level = mesh;
+    for (int s = 0; s <= SUBDIVISIONS; ++s) {
+        if (s > 0) level = subdivide(level);
+
+        Mesh ordered = level;
+        vector<int> order, rank;
+        VertexOrder::reverseCuthillMcKee(ordered.vertices.size(), ordered.triangles, order);
+        VertexOrder::apply(order, ordered.vertices, ordered.triangles, rank);
+
+        const int n = ordered.vertices.size();
+        SparseMatrix<double> L;
+        Laplacian::assemble(ordered.vertices, ordered.triangles, L, pool);
+
+        MatrixX3dRow rest(n, 3);
+        for (int i = 0; i < n; ++i) rest.row(i) = ordered.vertices[i].cast<double>().transpose();
+        const double diagonal = (rest.colwise().maxCoeff() - rest.colwise().minCoeff()).norm();
+
+        vector<int> byHeight(n);
+        for (int i = 0; i < n; ++i) byHeight[i] = i;
+        sort(byHeight.begin(), byHeight.end(), [&](int a, int b) { return rest(a, 1) < rest(b, 1); });
+
+        vector<int> anchors(byHeight.begin(), byHeight.begin() + ANCHORS);
+        anchors.insert(anchors.end(), byHeight.end() - ANCHORS, byHeight.end());
+        sort(anchors.begin(), anchors.end());
+
+        MatrixX3dRow targets = rest;
+        for (int k = n - ANCHORS; k < n; ++k) targets(byHeight[k], 0) += 0.05 * diagonal;
+
+        // Right-hand side of the rest pose (every rotation the identity) with the anchors moved
+        PCGSolver cg;
+        cg.reset(L);
+        cg.setAnchors(anchors);
+        MatrixX3dRow coupling;
+        cg.couplingProduct(targets, coupling, pool);
+        MatrixX3dRow rhs = L * rest - coupling;
+        for (int a : anchors) rhs.row(a) = targets.row(a);
+
+        Multigrid multigrid;
+        auto start = chrono::steady_clock::now();
+        multigrid.reset(L);
+        const double buildMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        start = chrono::steady_clock::now();
+        multigrid.setAnchors(anchors);
+        const double anchorMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        cg.setMultigrid(&multigrid);
+        cg.setPreconditioner(Preconditioner::MultigridCycles);
+        MatrixX3dRow x = rest;
+        start = chrono::steady_clock::now();
+        const int iterations = cg.solve(rhs, x, pool);
+        const double cgMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        x = rest;
+        start = chrono::steady_clock::now();
+        const int cycles = multigrid.solve(rhs, x, pool);
+        const double cycleMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        cout << "  n " << setw(7) << n << "  levels " << multigrid.getLevels() << "  build " << setw(7) << buildMs
+             << " ms  anchors " << setw(7) << anchorMs << " ms  PCG+V-cycle " << setw(3) << iterations << " it " << setw(8) << cgMs
+             << " ms (" << 1e3 * cgMs / (iterations * double(n)) << " us per vertex-iteration)  V-cycles " << setw(3) << cycles
+             << " " << setw(8) << cycleMs << " ms" << endl;
+    }
+}
+
+// ================== Vertex Orders
+
+// Local step and sparse products with the solver's vertices as loaded, in reverse
+// Cuthill-McKee order and in Morton order. Locality shows up here only as wall time and the
+// mean index span of an edge: cache misses are not counted.
+static void benchOrdering(const Mesh &mesh, ThreadPool &pool)
+{
+    const int REPEATS = 20;
+    const char *names[] = {"loaded", "RCM", "Morton"};
+
+    for (int o = MeshOrdering::LoadedOrder; o <= MeshOrdering::MortonCurve; ++o) {
+        Mesh ordered = mesh;
+        vector<int> order, rank;
+        const auto start = chrono::steady_clock::now();
+        if (o == MeshOrdering::CuthillMcKee) VertexOrder::reverseCuthillMcKee(ordered.vertices.size(), ordered.triangles, order);
+        if (o == MeshOrdering::MortonCurve) VertexOrder::morton(ordered.vertices, order);
+        if (!order.empty()) VertexOrder::apply(order, ordered.vertices, ordered.triangles, rank);
+        const double orderMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        System system(ordered, pool);
+        const int n = system.rest.rows();
+
+        // A smooth bend of the rest pose, the same shape in every order
+        MatrixX3dRow deformed = system.rest;
+        deformed.col(0) *= 1.1;
+        deformed.col(1) += 0.05 * deformed.col(0).cwiseProduct(deformed.col(0));
+
+        vector<Matrix3d> rotations(n);
+        MatrixX3dRow rhs(n, 3), product(n, 3);
+        double energy = 0;
+        const double localMs   = timeMs(REPEATS, [&]() { energy = localStep(system, deformed, rotations, rhs, pool); });
+        const double productMs = timeMs(REPEATS, [&]() { product.noalias() = system.L * deformed; });
+
+        FactorCache cache;
+        cache.reset(system.L);
+        const SparseLDLT &factor = cache.get(system.anchors);
+        const double iterationMs = timeMs(REPEATS, [&]() {
+            localStep(system, deformed, rotations, rhs, pool);
+            factor.solveInPlace(rhs);
+        });
+
+        cout << "  " << setw(14) << left << (o == MeshOrdering::LoadedOrder ? mesh.name : "") << setw(7) << names[o] << right
+             << " edge span " << setw(7) << VertexOrder::meanEdgeSpan(ordered.triangles) << "  reorder " << setw(6) << orderMs
+             << " ms  local step + RHS " << setw(6) << localMs << " ms  L x " << setw(5) << productMs << " ms  iteration "
+             << setw(6) << iterationMs << " ms  energy " << scientific << setprecision(11) << energy << fixed << setprecision(2) << endl;
+    }
+}
+
+// ================== Supernodal Factorization
+
+// Full factorizations of the anchored Laplacian with LDL^T and with the supernodal LL^T on
+// 1, 2, 4, ... threads, up to the hardware threads, for each fill-reducing ordering. The
+// orderings depend on the order they start from, so the vertices are renumbered by reverse
+// Cuthill-McKee first, as the viewer does by default.
+static void benchSupernodal(const Mesh &mesh, ThreadPool &pool)
+{
+    const int REPEATS = 5;
+
+    Mesh ordered = mesh;
+    vector<int> order, rank;
+    VertexOrder::reverseCuthillMcKee(ordered.vertices.size(), ordered.triangles, order);
+    VertexOrder::apply(order, ordered.vertices, ordered.triangles, rank);
+
+    SparseMatrix<double> L;
+    Laplacian::assemble(ordered.vertices, ordered.triangles, L, pool);
+    const int n = L.rows();
+
+    // Anchored rows and columns as FactorCache builds them: identity rows, entries kept as
+    // explicit zeros
+    vector<char> anchored(n, 0);
+    anchored[0] = anchored[n / 2] = 1;
+    SparseMatrix<double> A = L;
+    for (int j = 0; j < n; ++j) {
+        for (SparseMatrix<double>::InnerIterator it(A, j); it; ++it) {
+            if (anchored[j] || anchored[it.index()]) it.valueRef() = it.index() == j ? 1.0 : 0.0;
+        }
+    }
+
+    const int hardwareThreads = max(1u, thread::hardware_concurrency());
+
+    for (FillOrdering ordering : {FillOrdering::MinimumDegree, FillOrdering::NestedDissection, FillOrdering::ColumnMinimumDegree}) {
+        SparseLDLT ldlt;
+        ldlt.analyzePattern(A, ordering);
+        const double ldltMs = timeMs(REPEATS, [&]() { ldlt.factorize(A); });
+
+        SupernodalLLT supernodal;
+        supernodal.analyzePattern(A, ordering);
+
+        cout << "  " << setw(14) << left << mesh.name << setw(20) << FillReduction::name(ordering) << right
+             << " nnz(L) " << setw(8) << supernodal.nonZeros() << " (LDL^T " << ldlt.nonZeros() << ")  LDL^T " << setw(6) << ldltMs
+             << " ms  supernodal";
+        for (int threads = 1; threads <= hardwareThreads; threads *= 2) {
+            pool.setThreadCount(threads);
+            cout << "  " << threads << "t " << timeMs(REPEATS, [&]() { supernodal.factorize(A, pool); }) << " ms";
+        }
+        cout << "  work/span " << supernodal.workSpanRatio() << endl;
+    }
+    pool.setThreadCount(1);
+}
+
+int main(int argc, char *argv[])
+{
+    vector<string> paths;
+    for (int a = 1; a < argc; ++a) paths.push_back(argv[a]);
+    if (paths.empty()) paths = {"meshes/bunny.obj", "meshes/peter.obj"};
+
+    vector<Mesh> meshes;
+    for (const string &path : paths) {
+        Mesh mesh;
+        mesh.name = path.substr(path.find_last_of("/\\") + 1);
+        if (!MeshLoader::loadTriMesh(path, mesh.vertices, mesh.triangles)) return 1;
+        meshes.push_back(std::move(mesh));
+    }
+
+    ThreadPool pool(1);
+    cout << fixed << setprecision(2);
+
+    cout << endl << "Global step, one factor, two anchors: x, y and z solved separately or as one block (single thread)" << endl;
+    for (const Mesh &mesh : meshes) benchBlockSolve(mesh, pool);
+
+    cout << endl << "Local/global iterations with Anderson mixing, until the energy where plain alternation converges "
+         << "(relative decrease " << scientific << setprecision(0) << ENERGY_TOLERANCE << fixed << setprecision(2) << ", single thread)" << endl;
+    for (const Mesh &mesh : meshes) benchAnderson(mesh, pool);
+
+    cout << endl << "Local step rotation fits, " << RotationFit::batchWidth() << "-wide SVD batches against " << QUATERNION_ITERATIONS
+         << " warm-started quaternion steps (single thread)" << endl;
+    for (const Mesh &mesh : meshes) benchRotationFit(mesh, pool);
+
+    cout << endl << "Lazy local step on a partial drag, Anderson mixing over 5 (single thread)" << endl;
+    for (const Mesh &mesh : meshes) benchLazy(mesh, pool);
+
+    cout << endl << "Solver vertex orders (single thread; wall time only, cache misses are not measured)" << endl;
+    for (const Mesh &mesh : meshes) benchOrdering(mesh, pool);
+
+    cout << endl << "Multigrid on " << meshes.front().name << " under midpoint subdivision, reverse Cuthill-McKee order, "
+         << "one global solve to 1e-6 with 40 anchors (single thread)" << endl;
+    benchMultigrid(meshes.front(), pool);
+
+    const int hardwareThreads = max(1u, thread::hardware_concurrency());
+    cout << endl << "Full factorizations, two anchors, on 1 to " << hardwareThreads << " threads";
+    if (hardwareThreads == 1) cout << " (one hardware thread: no speedup is measured, only bounded by work/span)";
+    cout << endl;
+    for (const Mesh &mesh : meshes) benchSupernodal(mesh, pool);
+
+    return 0;
+}
@@ -109,6 +109,9 @@ void GLWidget::initializeGL()
 
 void GLWidget::paintGL()
 {
+    // Pick up the newest finished solve, if any; this never waits on the solver thread
+    m_arap.syncVertices();
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     m_defaultShader->bind();
@@ -262,6 +265,111 @@ void GLWidget::keyPressEvent(QKeyEvent *event)
     case Qt::Key_F: m_vertical -= SPEED; break;
     case Qt::Key_R: m_vertical += SPEED; break;
     case Qt::Key_C: m_camera.toggleIsOrbiting(); break;
+    case Qt::Key_Q: {
+        const bool useSvd = m_arap.getLocalSolver() != LocalSolver::SVD;
+        m_arap.setLocalSolver(useSvd ? LocalSolver::SVD : LocalSolver::WarmQuaternion);
+        cout << "Local step: "
+             << (useSvd ? "SVD" : "warm-started quaternions (slower than the batched SVDs per iteration and needs more iterations; see arap-bench)")
+             << endl;
+        break;
+    }
+    case Qt::Key_Z: {
+        m_arap.setLazyLocalStep(!m_arap.getLazyLocalStep());
+        cout << "Lazy local step: " << (m_arap.getLazyLocalStep() ? "on" : "off") << endl;
+        break;
+    }
+    case Qt::Key_X: {
+        const int window = m_arap.getAndersonWindow() > 0 ? 0 : 5;
+        m_arap.setAndersonWindow(window);
+        cout << "Anderson acceleration: " << (window > 0 ? "on" : "off") << endl;
+        break;
+    }
+    case Qt::Key_G: {
+        // Cycles LDL^T -> supernodal LL^T -> PCG with Jacobi, IC(0) or multigrid
+        // preconditioning -> multigrid V-cycles -> W-cycles -> LDL^T
+        if (m_arap.getGlobalSolver() == GlobalSolver::Factored) {
+            m_arap.setGlobalSolver(GlobalSolver::Supernodal);
+            cout << "Global step: supernodal LL^T factorization on " << m_arap.getThreadCount() << " threads" << endl;
+        } else if (m_arap.getGlobalSolver() == GlobalSolver::Supernodal) {
+            m_arap.setGlobalSolver(GlobalSolver::MatrixFreeCG);
+            m_arap.setPreconditioner(Preconditioner::JacobiScaling);
+            cout << "Global step: matrix-free PCG, Jacobi preconditioner" << endl;
+        } else if (m_arap.getGlobalSolver() == GlobalSolver::MatrixFreeCG && m_arap.getPreconditioner() == Preconditioner::JacobiScaling) {
+            m_arap.setPreconditioner(Preconditioner::IncompleteCholesky0);
+            cout << "Global step: matrix-free PCG, IC(0) preconditioner" << endl;
+        } else if (m_arap.getGlobalSolver() == GlobalSolver::MatrixFreeCG && m_arap.getPreconditioner() == Preconditioner::IncompleteCholesky0) {
+            m_arap.setPreconditioner(Preconditioner::MultigridCycles);
+            m_arap.setMultigridCycle(MultigridCycle::VCycle);
+            cout << "Global step: matrix-free PCG, multigrid V-cycle preconditioner" << endl;
+        } else if (m_arap.getGlobalSolver() == GlobalSolver::MatrixFreeCG) {
+            m_arap.setGlobalSolver(GlobalSolver::MultigridSolve);
+            m_arap.setPreconditioner(Preconditioner::JacobiScaling);
+            cout << "Global step: multigrid V-cycles" << endl;
+        } else if (m_arap.getMultigridCycle() == MultigridCycle::VCycle) {
+            m_arap.setMultigridCycle(MultigridCycle::WCycle);
+            cout << "Global step: multigrid W-cycles" << endl;
+        } else {
+            m_arap.setGlobalSolver(GlobalSolver::Factored);
+            m_arap.setMultigridCycle(MultigridCycle::VCycle);
+            cout << "Global step: sparse LDL^T factorization" << endl;
+        }
+        break;
+    }
+    case Qt::Key_N: {
+        // Cycles AMD -> COLAMD -> nested dissection -> identity -> AMD
+        const FillOrdering ordering = FillOrdering((m_arap.getFillOrdering() + 1) % 4);
+        m_arap.setFillOrdering(ordering);
+        cout << "Fill-reducing ordering: " << FillReduction::name(ordering) << endl;
+        break;
+    }
+    case Qt::Key_P: {
+        m_arap.setProxyMode(!m_arap.getProxyMode());
+        cout << "Proxy mode: " << (m_arap.getProxyMode() ? "on" : "off") << endl;
+        break;
+    }
+    case Qt::Key_L: {
+        m_arap.setSubspaceMode(!m_arap.getSubspaceMode());
+        cout << "Skinning subspace: " << (m_arap.getSubspaceMode() ? "on" : "off") << endl;
+        break;
+    }
+    case Qt::Key_K: {
+        // Cycles per-vertex rotations -> 1000 clusters -> 100 clusters, each by rest-space
+        // and then by geodesic distance -> per-vertex rotations
+        const int clusters = m_arap.getRotationClusters();
+        if (clusters > 0 && m_arap.getClusterMetric() == ClusterMetric::RestDistance) {
+            m_arap.setClusterMetric(ClusterMetric::GeodesicDistance);
+        } else {
+            m_arap.setClusterMetric(ClusterMetric::RestDistance);
+            m_arap.setRotationClusters(clusters == 0 ? 1000 : clusters == 1000 ? 100 : 0);
+        }
+        if (m_arap.getRotationClusters() == 0) {
+            cout << "Rotation clusters: off" << endl;
+        } else {
+            cout << "Rotation clusters: " << m_arap.getRotationClusters() << " by "
+                 << (m_arap.getClusterMetric() == ClusterMetric::GeodesicDistance ? "geodesic" : "rest-space") << " distance" << endl;
+        }
+        break;
+    }
+    case Qt::Key_E: {
+        m_arap.setGraphMode(!m_arap.getGraphMode());
+        cout << "Deformation graph: " << (m_arap.getGraphMode() ? "on" : "off") << endl;
+        break;
+    }
+    case Qt::Key_O: {
+        // Cycles reverse Cuthill-McKee -> Morton order -> the order of the file
+        const MeshOrdering ordering = m_arap.getMeshOrdering() == MeshOrdering::CuthillMcKee ? MeshOrdering::MortonCurve
+                                    : m_arap.getMeshOrdering() == MeshOrdering::MortonCurve  ? MeshOrdering::LoadedOrder
+                                                                                            : MeshOrdering::CuthillMcKee;
+        m_arap.setMeshOrdering(ordering);
+        cout << "Vertex order: " << (ordering == MeshOrdering::CuthillMcKee ? "reverse Cuthill-McKee"
+                                   : ordering == MeshOrdering::MortonCurve  ? "Morton code" : "as loaded") << endl;
+        break;
+    }
+    case Qt::Key_I: {
+        m_arap.setRegionMode(!m_arap.getRegionMode());
+        cout << "Region of interest: " << (m_arap.getRegionMode() ? "on" : "off") << endl;
+        break;
+    }
     case Qt::Key_Equal: m_vSize *= 11.0f / 10.0f; break;
     case Qt::Key_Minus: m_vSize *= 10.0f / 11.0f; break;
     case Qt::Key_Escape: QApplication::quit();
@@ -299,6 +407,9 @@ void GLWidget::tick()
     moveVec *= deltaSeconds;
     m_camera.move(moveVec);
 
+    // Keep converging the last drag while nothing else is asking for the solver
+    m_arap.refine();
+
     // Flag this view for repainting (Qt will call paintGL() soon after)
     update();
 }
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include "graphics/shader.h"
+#include "solver/threadpool.h"
 
 using namespace Eigen;
 using namespace std;
@@ -22,7 +23,8 @@ Shape::Shape() :
     m_vertices(),
     m_anchors(),
     m_modelMatrix(Matrix4f::Identity()),
-    lastSelected(-1)
+    lastSelected(-1),
+    m_pool(nullptr)
 {}
 
 // ================== Initialization and Updating
@@ -102,6 +104,10 @@ void Shape::setVertices(const vector<Vector3f> &vertices)
 
 void Shape::setModelMatrix(const Affine3f &model) { m_modelMatrix = model.matrix(); }
 
+// ================== Threading
+
+void Shape::setThreadPool(ThreadPool *pool) { m_pool = pool; }
+
 // ================== General Graphics Stuff
 
 void Shape::draw(Shader *shader, GLenum mode)
@@ -251,22 +257,33 @@ void Shape::updateMesh(const std::vector<Eigen::Vector3i> &faces,
                        std::vector<Eigen::Vector3f>& normals,
                        std::vector<Eigen::Vector3f>& colors)
 {
-    verts.reserve(faces.size() * 3);
-    normals.reserve(faces.size() * 3);
-
-    for (const Eigen::Vector3i& face : faces) {
-        Vector3f n = getNormal(face);
-
-        for (auto& v: {face[0], face[1], face[2]}) {
-            normals.push_back(n);
-            verts.push_back(vertices[v]);
-
-            if (m_anchors.find(v) == m_anchors.end()) {
-                colors.push_back(Vector3f(1,0,0));
-            } else {
-                colors.push_back(Vector3f(0, 1 - m_green, 1 - m_blue));
+    verts.resize(faces.size() * 3);
+    normals.resize(faces.size() * 3);
+    colors.resize(faces.size() * 3);
+
+    // Every face writes its own three slots, so faces can be processed in any order
+    auto fill = [&](int begin, int end) {
+        for (int f = begin; f < end; ++f) {
+            const Eigen::Vector3i& face = faces[f];
+            Vector3f n = getNormal(face);
+
+            for (int k = 0; k < 3; ++k) {
+                const int v = face[k];
+                normals[3 * f + k] = n;
+                verts[3 * f + k]   = vertices[v];
+
+                if (m_anchors.find(v) == m_anchors.end()) {
+                    colors[3 * f + k] = Vector3f(1,0,0);
+                } else {
+                    colors[3 * f + k] = Vector3f(0, 1 - m_green, 1 - m_blue);
+                }
             }
         }
+    };
+
+    if (m_pool != nullptr) {
+        m_pool->parallelFor(0, faces.size(), fill, 1024);
+    } else {
+        fill(0, faces.size());
     }
 }
-
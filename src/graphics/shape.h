@@ -20,6 +20,7 @@ enum SelectMode
 };
 
 class Shader;
+class ThreadPool;
 
 class Shape
 {
@@ -31,6 +32,9 @@ public:
 
     void setModelMatrix(const Eigen::Affine3f &model);
 
+    // Pool used to rebuild per-face buffers in parallel; nullptr rebuilds them serially
+    void setThreadPool(ThreadPool *pool);
+
     void draw(Shader *shader, GLenum mode);
     SelectMode select(Shader *shader, int vertex);
     bool selectWithSpecifiedMode(Shader *shader, int vertex, SelectMode mode);
@@ -60,6 +64,8 @@ private:
     Eigen::Matrix4f m_modelMatrix;
     int lastSelected = -1;
 
+    ThreadPool *m_pool;
+
     // Helpers
 
     void selectHelper();
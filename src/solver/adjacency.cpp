@@ -0,0 +1,44 @@
+#include "adjacency.h"
+
+using namespace std;
+using namespace Eigen;
+
+Adjacency::Adjacency() :
+    m_offsets(),
+    m_neighbors()
+{}
+
+void Adjacency::build(const SparseMatrix<double> &L, const MatrixX3dRow &rest)
+{
+    const int n = L.outerSize();
+    m_offsets.assign(n + 1, 0);
+    m_neighbors.clear();
+    m_neighbors.reserve(L.nonZeros() - n);
+
+    for (int i = 0; i < n; ++i) {
+        for (SparseMatrix<double>::InnerIterator it(L, i); it; ++it) {
+            const int j = it.index();
+            if (j == i) continue;
+
+            Neighbor neighbor;
+            for (int c = 0; c < 3; ++c) neighbor.restEdge[c] = rest(i, c) - rest(j, c);
+            neighbor.weight = -it.value();
+            neighbor.vertex = j;
+            m_neighbors.push_back(neighbor);
+        }
+        m_offsets[i + 1] = m_neighbors.size();
+    }
+}
+
+double Adjacency::meanEdgeLength() const
+{
+    if (m_neighbors.empty()) return 1.0;
+    double length = 0;
+    for (const Neighbor &neighbor : m_neighbors) length += restEdge(neighbor).norm();
+    return length / m_neighbors.size();
+}
+
+long Adjacency::memoryUsage() const
+{
+    return m_offsets.size() * sizeof(int) + m_neighbors.size() * sizeof(Neighbor);
+}
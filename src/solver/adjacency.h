@@ -0,0 +1,50 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#define EIGEN_DONT_VECTORIZE
+#define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
+#include "Eigen/Dense"
+#include "Eigen/Sparse"
+
+#include "solver/laplacian.h"
+
+// One-ring adjacency of a mesh in compressed rows, for the passes of the local/global
+// iterations that run over every edge. The neighbours of each vertex are stored in vertex
+// order, each beside its cotangent weight w_ij and rest edge p_i - p_j, so a pass streams
+// through one array instead of following L's indices and gathering rest positions.
+class Adjacency
+{
+public:
+    struct Neighbor
+    {
+        double restEdge[3];
+        double weight;
+        int    vertex;
+    };
+
+    Adjacency();
+
+    // Off-diagonal pattern and weights of L (w_ij = -L_ij) with the rest edges of rest
+    void build(const Eigen::SparseMatrix<double> &L, const MatrixX3dRow &rest);
+
+    int  vertices() const { return m_offsets.empty() ? 0 : m_offsets.size() - 1; }
+    long slots()    const { return m_neighbors.size(); }
+
+    std::span<const Neighbor> neighbors(int i) const
+    {
+        return std::span<const Neighbor>(m_neighbors.data() + m_offsets[i], m_offsets[i + 1] - m_offsets[i]);
+    }
+
+    static Eigen::Map<const Eigen::Vector3d> restEdge(const Neighbor &neighbor) { return Eigen::Map<const Eigen::Vector3d>(neighbor.restEdge); }
+
+    // Mean length of the rest edges
+    double meanEdgeLength() const;
+
+    long memoryUsage() const;
+
+private:
+    std::vector<int>      m_offsets;
+    std::vector<Neighbor> m_neighbors;
+};
@@ -0,0 +1,74 @@
+#include "anderson.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace Eigen;
+
+Anderson::Anderson() :
+    m_window(0),
+    m_columns(0),
+    m_next(0),
+    m_hasPrevious(false)
+{}
+
+void Anderson::reset(int dimension, int window)
+{
+    m_window = max(window, 0);
+    m_dG.resize(dimension, m_window);
+    m_dF.resize(dimension, m_window);
+    m_normal.resize(m_window, m_window);
+    m_previousG.resize(dimension);
+    m_previousF.resize(dimension);
+    m_residual.resize(dimension);
+    restart();
+}
+
+void Anderson::restart()
+{
+    m_columns     = 0;
+    m_next        = 0;
+    m_hasPrevious = false;
+}
+
+void Anderson::accelerate(const Ref<const VectorXd> &g, Ref<VectorXd> x)
+{
+    if (m_window == 0) {
+        x = g;
+        return;
+    }
+
+    m_residual = g - x;
+
+    if (m_hasPrevious) {
+        // Overwrite the oldest difference; the order of the columns does not matter to the
+        // least-squares problem, so the ring buffer is never rotated
+        const int column = m_next;
+        m_dG.col(column) = g - m_previousG;
+        m_dF.col(column) = m_residual - m_previousF;
+        m_columns = min(m_columns + 1, m_window);
+        m_next    = (m_next + 1) % m_window;
+
+        for (int c = 0; c < m_columns; ++c) {
+            const double entry = m_dF.col(c).dot(m_dF.col(column));
+            m_normal(c, column) = entry;
+            m_normal(column, c) = entry;
+        }
+    }
+
+    m_previousG   = g;
+    m_previousF   = m_residual;
+    m_hasPrevious = true;
+
+    if (m_columns == 0) {
+        x = g;
+        return;
+    }
+
+    // The Gram matrix turns singular as the iteration converges and the differences
+    // become parallel, so solve it in the minimum-norm sense
+    const VectorXd projected = m_dF.leftCols(m_columns).transpose() * m_residual;
+    const VectorXd theta     = m_normal.topLeftCorner(m_columns, m_columns).completeOrthogonalDecomposition().solve(projected);
+
+    x = g - m_dG.leftCols(m_columns) * theta;
+}
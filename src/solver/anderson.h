@@ -0,0 +1,49 @@
+#pragma once
+
+#define EIGEN_DONT_VECTORIZE
+#define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
+#include "Eigen/Dense"
+
+// Anderson acceleration of a fixed-point iteration x <- G(x) (Peng et al. 2018). The last
+// few differences of G(x) and of the residual F(x) = G(x) - x are kept, and each new
+// iterate is the combination of past images that minimizes the linearized residual:
+//
+//   theta = argmin |F_k - dF theta|,   x_{k+1} = G(x_k) - dG theta
+//
+// Nothing here knows about energies: callers that need monotonicity compare the energy
+// of the accelerated iterate against the last accepted one, and fall back to the plain
+// image G(x_k) (and restart()) when it went up.
+class Anderson
+{
+public:
+    Anderson();
+
+    // Sets the vector length and how many past differences to keep, and clears the history
+    void reset(int dimension, int window);
+
+    // Forgets the history but keeps the dimension and window
+    void restart();
+
+    // Given the image g = G(x) of the current iterate x, overwrites x with the next
+    // accelerated iterate. With no history yet, that is g itself.
+    void accelerate(const Eigen::Ref<const Eigen::VectorXd> &g, Eigen::Ref<Eigen::VectorXd> x);
+
+    int getWindow()  const { return m_window;  }
+    int getColumns() const { return m_columns; }
+
+private:
+    int m_window;
+    int m_columns;
+    int m_next;
+
+    // Column-wise ring buffers of dG and dF, and the Gram matrix dF^T dF kept up to date
+    // one row and column at a time
+    Eigen::MatrixXd m_dG;
+    Eigen::MatrixXd m_dF;
+    Eigen::MatrixXd m_normal;
+
+    Eigen::VectorXd m_previousG;
+    Eigen::VectorXd m_previousF;
+    Eigen::VectorXd m_residual;
+    bool            m_hasPrevious;
+};
@@ -0,0 +1,183 @@
+#include "clustering.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <queue>
+
+using namespace std;
+using namespace Eigen;
+
+void Clustering::farthestPoints(const MatrixXd &points, int count, vector<int> &seeds)
+{
+    const int n = points.rows();
+    count = min(count, n);
+    if (n == 0) return;
+    if (seeds.empty()) seeds.push_back(0);
+
+    VectorXd distance = VectorXd::Constant(n, numeric_limits<double>::infinity());
+    for (int s : seeds) distance = distance.cwiseMin((points.rowwise() - points.row(s)).rowwise().squaredNorm());
+
+    while ((int) seeds.size() < count) {
+        int farthest;
+        if (distance.maxCoeff(&farthest) <= 0) break;
+        seeds.push_back(farthest);
+        distance = distance.cwiseMin((points.rowwise() - points.row(farthest)).rowwise().squaredNorm());
+    }
+}
+
+int Clustering::kMeans(const MatrixXd &points, int k, vector<int> &labels, ThreadPool &pool, int iterations)
+{
+    const int n = points.rows();
+    const int d = points.cols();
+
+    vector<int> seeds;
+    farthestPoints(points, k, seeds);
+    k = seeds.size();
+
+    MatrixXd centers(k, d);
+    for (int c = 0; c < k; ++c) centers.row(c) = points.row(seeds[c]);
+
+    labels.assign(n, 0);
+    vector<int> counts(k);
+
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        atomic<bool> changed(false);
+
+        pool.parallelFor(0, n, [&](int begin, int end) {
+            bool chunkChanged = false;
+            for (int i = begin; i < end; ++i) {
+                int best;
+                (centers.rowwise() - points.row(i)).rowwise().squaredNorm().minCoeff(&best);
+                if (best != labels[i]) {
+                    labels[i]    = best;
+                    chunkChanged = true;
+                }
+            }
+            if (chunkChanged) changed = true;
+        });
+
+        if (!changed && iteration > 0) break;
+
+        MatrixXd sums = MatrixXd::Zero(k, d);
+        fill(counts.begin(), counts.end(), 0);
+        for (int i = 0; i < n; ++i) {
+            sums.row(labels[i]) += points.row(i);
+            ++counts[labels[i]];
+        }
+        for (int c = 0; c < k; ++c) {
+            if (counts[c] > 0) centers.row(c) = sums.row(c) / counts[c];
+        }
+
+        // An emptied cluster restarts at the point farthest from its own center, which then
+        // is that center, so several empty clusters never pick the same point
+        for (int c = 0; c < k; ++c) {
+            if (counts[c] > 0) continue;
+            int    farthest = -1;
+            double distance = 0;
+            for (int i = 0; i < n; ++i) {
+                const double squared = (points.row(i) - centers.row(labels[i])).squaredNorm();
+                if (squared > distance) {
+                    distance = squared;
+                    farthest = i;
+                }
+            }
+            if (farthest < 0) continue;
+            --counts[labels[farthest]];
+            ++counts[c];
+            labels[farthest] = c;
+            centers.row(c)   = points.row(farthest);
+        }
+    }
+
+    return renumber(labels, k);
+}
+
+int Clustering::geodesicKMeans(const SparseMatrix<double> &L, const MatrixXd &points, int k, vector<int> &labels, int iterations)
+{
+    const int n = points.rows();
+
+    vector<int> centers;
+    farthestPoints(points, k, centers);
+    k = centers.size();
+
+    VectorXd distance(n);
+    typedef pair<double, int> Entry;
+
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        // Voronoi regions of the centers under edge-path distance
+        priority_queue<Entry, vector<Entry>, greater<Entry>> queue;
+        distance.setConstant(numeric_limits<double>::infinity());
+        labels.assign(n, -1);
+        for (int c = 0; c < k; ++c) {
+            distance[centers[c]] = 0;
+            labels[centers[c]]   = c;
+            queue.emplace(0.0, centers[c]);
+        }
+        while (!queue.empty()) {
+            const auto [d, i] = queue.top();
+            queue.pop();
+            if (d > distance[i]) continue;
+
+            for (SparseMatrix<double>::InnerIterator it(L, i); it; ++it) {
+                const int j = it.index();
+                if (j == i) continue;
+                const double through = d + (points.row(i) - points.row(j)).norm();
+                if (through < distance[j]) {
+                    distance[j] = through;
+                    labels[j]   = labels[i];
+                    queue.emplace(through, j);
+                }
+            }
+        }
+
+        // Vertices on components without a center go to the nearest one in space
+        for (int i = 0; i < n; ++i) {
+            if (labels[i] >= 0) continue;
+            double nearest = numeric_limits<double>::infinity();
+            for (int c = 0; c < k; ++c) {
+                const double d = (points.row(centers[c]) - points.row(i)).squaredNorm();
+                if (d < nearest) {
+                    nearest   = d;
+                    labels[i] = c;
+                }
+            }
+        }
+
+        MatrixXd centroids = MatrixXd::Zero(k, points.cols());
+        vector<int> counts(k, 0);
+        for (int i = 0; i < n; ++i) {
+            centroids.row(labels[i]) += points.row(i);
+            ++counts[labels[i]];
+        }
+        for (int c = 0; c < k; ++c) centroids.row(c) /= max(counts[c], 1);
+
+        vector<int>    moved = centers;
+        vector<double> best(k, numeric_limits<double>::infinity());
+        for (int i = 0; i < n; ++i) {
+            const double d = (points.row(i) - centroids.row(labels[i])).squaredNorm();
+            if (d < best[labels[i]]) {
+                best[labels[i]]  = d;
+                moved[labels[i]] = i;
+            }
+        }
+        if (moved == centers) break;
+        centers.swap(moved);
+    }
+
+    return renumber(labels, k);
+}
+
+// Renumbers the clusters that kept at least one point to [0, used)
+int Clustering::renumber(vector<int> &labels, int k)
+{
+    vector<int> number(k, -1);
+    int used = 0;
+    for (int &label : labels) {
+        if (number[label] < 0) number[label] = used++;
+        label = number[label];
+    }
+    return used;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#define EIGEN_DONT_VECTORIZE
+#define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
+#include "Eigen/Dense"
+#include "Eigen/Sparse"
+
+class ThreadPool;
+
+// Grouping of points (rows of a matrix, in any dimension) for the reduced solvers
+class Clustering
+{
+public:
+    // Extends seeds with points, each as far as possible from all chosen so far; with no
+    // seeds the first point is taken
+    static void farthestPoints(const Eigen::MatrixXd &points, int count, std::vector<int> &seeds);
+
+    // Lloyd's k-means seeded by farthest points, so the result is deterministic. Writes
+    // a cluster in [0, k) per point. A cluster that empties restarts at the point farthest
+    // from its center; any still empty at the end (only possible with coincident points)
+    // are dropped and the rest renumbered, so the returned count can be below k.
+    static int kMeans(const Eigen::MatrixXd &points, int k, std::vector<int> &labels, ThreadPool &pool, int iterations = 20);
+
+    // k-means with shortest-path distance along the edges of a mesh (the off-diagonal
+    // pattern of its Laplacian) in place of straight-line distance, so that clusters are
+    // connected patches and never bridge two parts that only touch in space. Each round
+    // grows the regions of all centers at once with one multi-source Dijkstra, then moves
+    // each center to the member closest to the region's centroid.
+    static int geodesicKMeans(const Eigen::SparseMatrix<double> &L, const Eigen::MatrixXd &points, int k,
+                              std::vector<int> &labels, int iterations = 10);
+
+private:
+    Clustering();
+
+    static int renumber(std::vector<int> &labels, int k);
+};
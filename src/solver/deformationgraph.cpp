@@ -0,0 +1,237 @@
+#include "deformationgraph.h"
+#include "clustering.h"
+#include "rotationfit.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+using namespace Eigen;
+
+DeformationGraph::DeformationGraph() :
+    m_targetNodes(0),
+    m_extent(1.0),
+    m_factored(false),
+    m_anchorWeight(0.0)
+{}
+
+void DeformationGraph::reset()
+{
+    m_nodes.resize(0, 3);
+    m_deformedNodes.resize(0, 3);
+    m_anchors.clear();
+    m_factored = false;
+}
+
+void DeformationGraph::build(const MatrixX3dRow &rest, int nodeCount, ThreadPool &pool)
+{
+    const int n = rest.rows();
+    const int K = NODES_PER_VERTEX;
+    m_targetNodes = nodeCount;
+    m_extent      = max((rest.colwise().maxCoeff() - rest.colwise().minCoeff()).norm(), 1e-12);
+
+    vector<int> seeds;
+    Clustering::farthestPoints(MatrixXd(rest), max(nodeCount, 1), seeds);
+    const int m = seeds.size();
+
+    m_nodes.resize(m, 3);
+    for (int k = 0; k < m; ++k) m_nodes.row(k) = rest.row(seeds[k]);
+
+    m_restVertices.resize(3 * n);
+    m_vertexNodes.assign(K * n, 0);
+    m_vertexWeights.assign(K * n, 0.0f);
+
+    // Weights (1 - d_k / d_max)^2 over the K nearest nodes, with d_max the distance to the
+    // next nearest one, normalized to sum to one
+    pool.parallelFor(0, n, [&](int begin, int end) {
+        vector<pair<double, int>> nearest;
+        for (int i = begin; i < end; ++i) {
+            for (int c = 0; c < 3; ++c) m_restVertices[3 * i + c] = rest(i, c);
+
+            nearest.clear();
+            for (int k = 0; k < m; ++k) nearest.emplace_back((m_nodes.row(k) - rest.row(i)).norm(), k);
+            const int used = min(K, m);
+            const int cut  = min(K + 1, m);
+            partial_sort(nearest.begin(), nearest.begin() + cut, nearest.end());
+
+            const double dmax = nearest[cut - 1].first;
+            double sum = 0;
+            for (int k = 0; k < used; ++k) {
+                const double w = dmax > 0 ? (1.0 - nearest[k].first / dmax) * (1.0 - nearest[k].first / dmax) : 1.0;
+                m_vertexNodes[K * i + k]   = nearest[k].second;
+                m_vertexWeights[K * i + k] = w;
+                sum += w;
+            }
+            // Equidistant from all its nodes: fall back to the nearest one
+            if (sum <= 0) {
+                m_vertexWeights[K * i] = 1.0f;
+                sum = 1.0;
+            }
+            for (int k = 0; k < used; ++k) m_vertexWeights[K * i + k] /= sum;
+        }
+    });
+
+    // Nodes that influence a common vertex are joined by an edge
+    vector<pair<int, int>> edges;
+    for (int i = 0; i < n; ++i) {
+        for (int a = 0; a < K; ++a) {
+            for (int b = a + 1; b < K; ++b) {
+                if (m_vertexWeights[K * i + a] <= 0 || m_vertexWeights[K * i + b] <= 0) continue;
+                const int j = m_vertexNodes[K * i + a], k = m_vertexNodes[K * i + b];
+                edges.emplace_back(min(j, k), max(j, k));
+            }
+        }
+    }
+    sort(edges.begin(), edges.end());
+    edges.erase(unique(edges.begin(), edges.end()), edges.end());
+
+    vector<Triplet<double>> entries;
+    VectorXd degree = VectorXd::Zero(m);
+    for (const auto &[j, k] : edges) {
+        entries.emplace_back(j, k, -1.0);
+        entries.emplace_back(k, j, -1.0);
+        degree[j] += 1;
+        degree[k] += 1;
+    }
+    for (int k = 0; k < m; ++k) entries.emplace_back(k, k, degree[k]);
+    m_graphL.resize(m, m);
+    m_graphL.setFromTriplets(entries.begin(), entries.end());
+
+    m_deformedNodes = m_nodes;
+    m_rotations.assign(m, Matrix3d::Identity());
+    m_transforms.assign(12 * m, 0.0f);
+    for (int k = 0; k < m; ++k) {
+        for (int c = 0; c < 3; ++c) m_transforms[12 * k + 5 * c] = 1.0f;
+    }
+    m_anchors.clear();
+    m_factored = false;
+}
+
+bool DeformationGraph::setAnchors(const vector<int> &anchors)
+{
+    if (m_factored && anchors == m_anchors) return false;
+    m_anchors = anchors;
+
+    const int m = m_nodes.rows();
+    const int K = NODES_PER_VERTEX;
+
+    vector<Triplet<double>> entries;
+    for (unsigned long a = 0; a < anchors.size(); ++a) {
+        for (int k = 0; k < K; ++k) {
+            const float w = m_vertexWeights[K * anchors[a] + k];
+            if (w > 0) entries.emplace_back(a, m_vertexNodes[K * anchors[a] + k], w);
+        }
+    }
+    m_W.resize(anchors.size(), m);
+    m_W.setFromTriplets(entries.begin(), entries.end());
+
+    const double meanDiagonal = m_graphL.diagonal().mean();
+    m_anchorWeight = ANCHOR_WEIGHT * meanDiagonal;
+
+    SparseMatrix<double> identity(m, m);
+    identity.setIdentity();
+    const SparseMatrix<double> system = m_graphL + m_anchorWeight * SparseMatrix<double>(m_W.transpose() * m_W)
+                                      + PROXIMAL_WEIGHT * meanDiagonal * identity;
+
+    m_factor.analyzePattern(system);
+    m_factored = m_factor.factorize(system);
+    return true;
+}
+
+int DeformationGraph::solve(const MatrixX3dRow &anchorTargets, int maxIterations, double tolerance)
+{
+    if (!m_factored) return 0;
+
+    const int m = m_nodes.rows();
+    const int K = NODES_PER_VERTEX;
+    const double proximal = PROXIMAL_WEIGHT * m_graphL.diagonal().mean();
+
+    MatrixX3dRow rhs(m, 3);
+    MatrixX3dRow offsets(m_anchors.size(), 3);
+
+    int iteration = 0;
+    while (iteration < maxIterations) {
+        ++iteration;
+
+        // Local step: ARAP rotations of the nodes over their graph neighbours
+        for (int j = 0; j < m; ++j) {
+            Matrix3d covariance = Matrix3d::Zero();
+            for (SparseMatrix<double>::InnerIterator it(m_graphL, j); it; ++it) {
+                const int k = it.index();
+                if (k == j) continue;
+                const Vector3d restEdge     = (m_nodes.row(j) - m_nodes.row(k)).transpose();
+                const Vector3d deformedEdge = (m_deformedNodes.row(j) - m_deformedNodes.row(k)).transpose();
+                covariance -= it.value() * restEdge * deformedEdge.transpose();
+            }
+            m_rotations[j] = covariance;
+        }
+        RotationFit::fit(m_rotations.data(), m_rotations.data(), m);
+
+        // Global step: (L + mu W^T W) g' = b + mu W^T (t - c), where c_a = sum_k w_ak R_k (p_a - g_k)
+        // is the part of an anchored vertex's position that the rotations already decide
+        for (int j = 0; j < m; ++j) {
+            Vector3d b = proximal * m_deformedNodes.row(j).transpose();
+            for (SparseMatrix<double>::InnerIterator it(m_graphL, j); it; ++it) {
+                const int k = it.index();
+                if (k == j) continue;
+                const Vector3d restEdge = (m_nodes.row(j) - m_nodes.row(k)).transpose();
+                b -= 0.5 * it.value() * (m_rotations[j] + m_rotations[k]) * restEdge;
+            }
+            rhs.row(j) = b.transpose();
+        }
+        for (unsigned long a = 0; a < m_anchors.size(); ++a) {
+            const int i = m_anchors[a];
+            const Vector3d p(m_restVertices[3 * i], m_restVertices[3 * i + 1], m_restVertices[3 * i + 2]);
+            Vector3d c = Vector3d::Zero();
+            for (int k = 0; k < K; ++k) {
+                const int node = m_vertexNodes[K * i + k];
+                c += m_vertexWeights[K * i + k] * (m_rotations[node] * (p - m_nodes.row(node).transpose()));
+            }
+            offsets.row(a) = anchorTargets.row(a) - c.transpose();
+        }
+        rhs += m_anchorWeight * (m_W.transpose() * offsets);
+
+        m_factor.solveInPlace(rhs);
+        const double change = (rhs - m_deformedNodes).rowwise().norm().maxCoeff();
+        m_deformedNodes.swap(rhs);
+
+        if (change <= tolerance * m_extent) break;
+    }
+
+    // [R_k | g'_k - R_k g_k] per node, for the skinning pass
+    for (int k = 0; k < m; ++k) {
+        const Vector3d t = m_deformedNodes.row(k).transpose() - m_rotations[k] * m_nodes.row(k).transpose();
+        float *T = &m_transforms[12 * k];
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c) T[4 * r + c] = m_rotations[k](r, c);
+            T[4 * r + 3] = t[r];
+        }
+    }
+    return iteration;
+}
+
+// p'_i = (sum_k w_ik T_k) [p_i; 1]: blending the transforms first leaves one affine map
+// per vertex, and the fixed-size inner loops over 12 floats vectorize
+void DeformationGraph::deform(MatrixX3dRow &positions, ThreadPool &pool) const
+{
+    const int n = m_restVertices.size() / 3;
+    const int K = NODES_PER_VERTEX;
+    positions.resize(n, 3);
+
+    pool.parallelFor(0, n, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            float blend[12] = {};
+            for (int k = 0; k < K; ++k) {
+                const float  w = m_vertexWeights[K * i + k];
+                const float *T = &m_transforms[12 * m_vertexNodes[K * i + k]];
+                for (int c = 0; c < 12; ++c) blend[c] += w * T[c];
+            }
+
+            const float *p = &m_restVertices[3 * i];
+            for (int r = 0; r < 3; ++r) {
+                positions(i, r) = blend[4 * r] * p[0] + blend[4 * r + 1] * p[1] + blend[4 * r + 2] * p[2] + blend[4 * r + 3];
+            }
+        }
+    }, 1024);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+
+#define EIGEN_DONT_VECTORIZE
+#define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
+#include "Eigen/Dense"
+#include "Eigen/Sparse"
+
+#include "solver/laplacian.h"
+#include "solver/sparseldlt.h"
+
+class ThreadPool;
+
+// Embedded deformation (Sumner et al. 2007): a sparse graph of nodes g_k sampled over the
+// surface carries the deformation, and every vertex follows the affine transforms of its
+// nearest nodes,
+//
+//   p'_i = sum_k w_ik (R_k (p_i - g_k) + g'_k)
+//
+// The nodes are solved with ARAP local/global iterations on the graph, whose edges join
+// nodes that influence a common vertex. Anchored vertices enter the node system as a
+// stiff penalty on their blended positions, since they are not nodes themselves.
+//
+// Sampling, weights and the graph depend only on the rest shape and are built once; the
+// node system is refactored per anchor set. Its size is the node count, so iterations
+// cost the same whatever the resolution of the mesh, which is only touched by deform().
+class DeformationGraph
+{
+public:
+    DeformationGraph();
+
+    // Samples about nodeCount nodes by farthest points and weights each vertex by its
+    // NODES_PER_VERTEX nearest ones
+    void build(const MatrixX3dRow &rest, int nodeCount, ThreadPool &pool);
+
+    bool isBuilt()        const { return m_nodes.rows() > 0; }
+    int  getTargetNodes() const { return m_targetNodes; }
+    int  getNodeCount()   const { return m_nodes.rows(); }
+
+    // Drops the graph, e.g. for a new mesh
+    void reset();
+
+    // Factors the node system for the (sorted) anchors unless they are the cached ones;
+    // returns whether it did
+    bool setAnchors(const std::vector<int> &anchors);
+
+    // Local/global iterations on the nodes with the anchors pulled to their targets (one
+    // row per anchor), until the nodes move by less than tolerance relative to the size
+    // of the graph; returns the iterations taken, maxIterations if it did not converge
+    int solve(const MatrixX3dRow &anchorTargets, int maxIterations, double tolerance);
+
+    // Blends the node transforms over every vertex, in parallel
+    void deform(MatrixX3dRow &positions, ThreadPool &pool) const;
+
+private:
+    static const int NODES_PER_VERTEX = 4;
+
+    // Weight of the anchor penalty relative to the mean diagonal of the graph Laplacian
+    static constexpr double ANCHOR_WEIGHT = 1e3;
+
+    // Keeps nodes of components without anchors where they are; negligible elsewhere
+    static constexpr double PROXIMAL_WEIGHT = 1e-8;
+
+    int    m_targetNodes;
+    double m_extent;
+
+    // Rest vertices in single precision, and each vertex's nodes and weights, packed
+    // NODES_PER_VERTEX to a vertex for the skinning pass
+    std::vector<float> m_restVertices;
+    std::vector<int>   m_vertexNodes;
+    std::vector<float> m_vertexWeights;
+
+    // Rest and deformed node positions, node rotations, and the graph Laplacian (unit
+    // weights per edge)
+    MatrixX3dRow                 m_nodes;
+    MatrixX3dRow                 m_deformedNodes;
+    std::vector<Eigen::Matrix3d> m_rotations;
+    Eigen::SparseMatrix<double>  m_graphL;
+
+    // Anchor penalty: W maps node positions to anchored vertex positions, and the node
+    // system L + mu W^T W is factored once per anchor set
+    std::vector<int>            m_anchors;
+    bool                        m_factored;
+    double                      m_anchorWeight;
+    Eigen::SparseMatrix<double> m_W;
+    SparseLDLT                  m_factor;
+
+    // Per-node affine transforms [R_k | g'_k - R_k g_k], row-major, for deform()
+    std::vector<float> m_transforms;
+};
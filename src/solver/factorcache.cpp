@@ -0,0 +1,201 @@
+#include "factorcache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+
+using namespace std;
+using namespace Eigen;
+
+FactorCache::FactorCache() :
+    m_L(),
+    m_constrained(),
+    m_factor(),
+    m_supernodal(),
+    m_coupling(),
+    m_anchors(),
+    m_anchored(),
+    m_ordering(FillOrdering::MinimumDegree),
+    m_valid(false),
+    m_supernodalAnalyzed(false),
+    m_supernodalValid(false),
+    m_rowUpdates(0),
+    m_hits(0),
+    m_misses(0),
+    m_updates(0),
+    m_analyzeTime(0),
+    m_factorTime(0)
+{}
+
+void FactorCache::reset(const SparseMatrix<double> &L, FillOrdering ordering)
+{
+    m_L = L;
+    m_constrained = L;
+    m_ordering = ordering;
+
+    auto start = chrono::steady_clock::now();
+    m_factor.analyzePattern(m_constrained, ordering);
+    m_analyzeTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    m_anchors.clear();
+    m_anchored.assign(L.cols(), false);
+    m_coupling.resize(L.rows(), 0);
+    m_valid              = false;
+    m_supernodalAnalyzed = false;
+    m_supernodalValid    = false;
+    m_rowUpdates = 0;
+    m_hits       = 0;
+    m_misses     = 0;
+    m_updates    = 0;
+}
+
+const SparseLDLT &FactorCache::get(const vector<int> &anchors)
+{
+    if (m_valid && anchors == m_anchors) {
+        ++m_hits;
+        return m_factor;
+    }
+
+    vector<int> added, removed;
+    set_difference(anchors.begin(), anchors.end(), m_anchors.begin(), m_anchors.end(), back_inserter(added));
+    set_difference(m_anchors.begin(), m_anchors.end(), anchors.begin(), anchors.end(), back_inserter(removed));
+
+    // Each row modification costs at most a few passes over L; beyond that, refactoring wins
+    const double changes = added.size() + removed.size();
+    const bool cheaper = changes * 4.0 * m_factor.nonZeros() < m_factor.flops();
+
+    if (m_valid && cheaper && m_rowUpdates + changes <= MAX_ROW_UPDATES && update(added, removed)) {
+        ++m_updates;
+    } else {
+        ++m_misses;
+        refactor(anchors);
+    }
+
+    m_anchors         = anchors;
+    m_valid           = true;
+    m_supernodalValid = false;
+    buildCoupling();
+    return m_factor;
+}
+
+const SupernodalLLT &FactorCache::getSupernodal(const vector<int> &anchors, ThreadPool &pool)
+{
+    if (m_supernodalValid && anchors == m_anchors) {
+        ++m_hits;
+        return m_supernodal;
+    }
+
+    if (!m_supernodalAnalyzed) {
+        auto start = chrono::steady_clock::now();
+        m_supernodal.analyzePattern(m_constrained, m_ordering);
+        m_analyzeTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        m_supernodalAnalyzed = true;
+    }
+
+    ++m_misses;
+    constrain(anchors);
+
+    auto start = chrono::steady_clock::now();
+    if (!m_supernodal.factorize(m_constrained, pool)) cerr << "Failed to factorize the anchored Laplacian" << endl;
+    m_factorTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    m_anchors         = anchors;
+    m_valid           = false;
+    m_supernodalValid = true;
+    buildCoupling();
+    return m_supernodal;
+}
+
+// Column c is column anchors[c] of L restricted to free rows, written straight into
+// compressed storage; anchor drags then only need L_fc x_c
+void FactorCache::buildCoupling()
+{
+    const int *outer = m_L.outerIndexPtr();
+    const int *inner = m_L.innerIndexPtr();
+
+    m_coupling.resize(m_L.rows(), m_anchors.size());
+    int *couplingOuter = m_coupling.outerIndexPtr();
+    couplingOuter[0] = 0;
+    for (unsigned long c = 0; c < m_anchors.size(); ++c) {
+        int count = 0;
+        for (int p = outer[m_anchors[c]]; p < outer[m_anchors[c] + 1]; ++p) count += !m_anchored[inner[p]];
+        couplingOuter[c + 1] = couplingOuter[c] + count;
+    }
+    m_coupling.resizeNonZeros(couplingOuter[m_anchors.size()]);
+
+    int q = 0;
+    for (int a : m_anchors) {
+        for (int p = outer[a]; p < outer[a + 1]; ++p) {
+            if (m_anchored[inner[p]]) continue;
+            m_coupling.innerIndexPtr()[q] = inner[p];
+            m_coupling.valuePtr()[q]      = m_L.valuePtr()[p];
+            ++q;
+        }
+    }
+}
+
+// Rewrites row and column `vertex` of the constrained matrix for its new anchor state
+void FactorCache::setAnchored(int vertex, bool anchored)
+{
+    m_anchored[vertex] = anchored;
+
+    const int *outer = m_L.outerIndexPtr();
+    const int *inner = m_L.innerIndexPtr();
+    for (int p = outer[vertex]; p < outer[vertex + 1]; ++p) {
+        const int i = inner[p];
+        const double value = (m_anchored[i] || m_anchored[vertex]) ? (i == vertex ? 1.0 : 0.0) : m_L.valuePtr()[p];
+
+        // L is symmetric, so (vertex, i) sits in column i at the same row position as p
+        m_constrained.valuePtr()[p] = value;
+        if (i != vertex) {
+            const int q = lower_bound(inner + outer[i], inner + outer[i + 1], vertex) - inner;
+            m_constrained.valuePtr()[q] = value;
+        }
+    }
+}
+
+// Rewrites the whole constrained matrix for the given anchor set
+void FactorCache::constrain(const vector<int> &anchors)
+{
+    m_anchored.assign(m_L.cols(), false);
+    for (int a : anchors) m_anchored[a] = true;
+
+    // Same pattern as L: anchored rows/columns become identity, entries kept as zeros
+    const double *source = m_L.valuePtr();
+    double       *target = m_constrained.valuePtr();
+    for (int j = 0; j < m_L.outerSize(); ++j) {
+        for (int p = m_L.outerIndexPtr()[j]; p < m_L.outerIndexPtr()[j + 1]; ++p) {
+            const int i = m_L.innerIndexPtr()[p];
+            if (m_anchored[i] || m_anchored[j]) target[p] = (i == j) ? 1.0 : 0.0;
+            else                                target[p] = source[p];
+        }
+    }
+}
+
+void FactorCache::refactor(const vector<int> &anchors)
+{
+    constrain(anchors);
+
+    auto start = chrono::steady_clock::now();
+    if (!m_factor.factorize(m_constrained)) cerr << "Failed to factorize the anchored Laplacian" << endl;
+    m_factorTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    m_rowUpdates = 0;
+}
+
+// Anchors are added before any are removed, so the system never passes through an
+// unanchored (singular) state on the way to a valid anchor set
+bool FactorCache::update(const vector<int> &added, const vector<int> &removed)
+{
+    for (int vertex : added) {
+        setAnchored(vertex, true);
+        if (!m_factor.deleteRow(vertex)) return false;
+    }
+    for (int vertex : removed) {
+        setAnchored(vertex, false);
+        if (!m_factor.addRow(vertex, m_constrained)) return false;
+    }
+
+    m_rowUpdates += added.size() + removed.size();
+    return true;
+}
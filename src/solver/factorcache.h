@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+
+#include "solver/sparseldlt.h"
+#include "solver/supernodalllt.h"
+
+// Holds the factorization of the anchored Laplacian, keyed by the anchor set it was
+// built for. Anchored rows and columns are replaced by identity rows while keeping
+// their entries as explicit zeros, so the sparsity pattern never changes: the symbolic
+// analysis (ordering plus elimination tree) runs once per mesh, and only the numeric
+// factorization reruns when the anchor set does.
+//
+// When only a few anchors were added or removed since the cached factor was built, it is
+// modified in place one row at a time instead of being refactored from scratch.
+//
+// The supernodal factor is an alternative for the same constrained matrix. It has no row
+// modifications, so every anchor change refactors it in full, in parallel on the pool.
+// Only one of the two factors is current at a time.
+class FactorCache
+{
+public:
+    FactorCache();
+
+    // Analyzes the pattern of L under the given fill-reducing ordering and drops any cached
+    // factor
+    void reset(const Eigen::SparseMatrix<double> &L, FillOrdering ordering = FillOrdering::MinimumDegree);
+
+    // Returns the factor for the given (sorted) anchor set, refactoring only on a miss
+    const SparseLDLT &get(const std::vector<int> &anchors);
+
+    // Same, but with the supernodal factorization; its symbolic analysis runs on first use
+    const SupernodalLLT &getSupernodal(const std::vector<int> &anchors, ThreadPool &pool);
+
+    // The current factor, whatever anchor set it was built for
+    const SparseLDLT &getFactor() const { return m_factor; }
+
+    // Columns of L for the cached anchors with anchored rows zeroed (L_fc), so the
+    // anchored values enter the right-hand side as b_f - L_fc x_c
+    const Eigen::SparseMatrix<double> &getCoupling() const { return m_coupling; }
+
+    int getHits()    const { return m_hits;    }
+    int getMisses()  const { return m_misses;  }
+    int getUpdates() const { return m_updates; }
+
+    // Wall-clock milliseconds of the symbolic analysis and of the last full factorization
+    double getAnalyzeTime() const { return m_analyzeTime; }
+    double getFactorTime()  const { return m_factorTime;  }
+
+private:
+    // Row modifications allowed before a full refactorization, to bound round-off drift
+    static const int MAX_ROW_UPDATES = 1024;
+
+    Eigen::SparseMatrix<double> m_L;
+    Eigen::SparseMatrix<double> m_constrained;
+    SparseLDLT                  m_factor;
+    SupernodalLLT               m_supernodal;
+    Eigen::SparseMatrix<double> m_coupling;
+
+    std::vector<int>  m_anchors;
+    std::vector<bool> m_anchored;
+    FillOrdering m_ordering;
+    bool m_valid;
+    bool m_supernodalAnalyzed;
+    bool m_supernodalValid;
+    int  m_rowUpdates;
+    int  m_hits;
+    int  m_misses;
+    int  m_updates;
+    double m_analyzeTime;
+    double m_factorTime;
+
+    void setAnchored(int vertex, bool anchored);
+    void constrain(const std::vector<int> &anchors);
+    void buildCoupling();
+    void refactor(const std::vector<int> &anchors);
+    bool update(const std::vector<int> &added, const std::vector<int> &removed);
+};
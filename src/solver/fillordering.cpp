@@ -0,0 +1,214 @@
+#include "fillordering.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "Eigen/OrderingMethods"
+
+using namespace std;
+using namespace Eigen;
+
+void FillReduction::order(const SparseMatrix<double> &A, FillOrdering ordering, vector<int> &perm)
+{
+    const int n = A.rows();
+
+    switch (ordering) {
+    case FillOrdering::IdentityOrdering:
+        perm.resize(n);
+        iota(perm.begin(), perm.end(), 0);
+        break;
+    case FillOrdering::MinimumDegree: {
+        PermutationMatrix<Dynamic, Dynamic, int> p;
+        AMDOrdering<int>()(A, p);
+        perm.assign(p.indices().data(), p.indices().data() + n);
+        break;
+    }
+    case FillOrdering::ColumnMinimumDegree: {
+        // Eigen's COLAMD hands back the inverse, p[old] = new
+        SparseMatrix<double> columns = A;
+        columns.makeCompressed();
+        PermutationMatrix<Dynamic, Dynamic, int> p;
+        COLAMDOrdering<int>()(columns, p);
+        perm.resize(n);
+        for (int i = 0; i < n; ++i) perm[p.indices()[i]] = i;
+        break;
+    }
+    case FillOrdering::NestedDissection:
+        nestedDissection(A, perm);
+        break;
+    }
+}
+
+void FillReduction::nestedDissection(const SparseMatrix<double> &A, vector<int> &perm)
+{
+    const int  n     = A.rows();
+    const int *outer = A.outerIndexPtr();
+    const int *inner = A.innerIndexPtr();
+
+    // A part of the graph still to be numbered, into positions [first, first + size)
+    struct Part
+    {
+        vector<int> vertices;
+        int         first;
+    };
+
+    perm.assign(n, -1);
+    vector<Part> stack;
+    stack.push_back({vector<int>(n), 0});
+    iota(stack.back().vertices.begin(), stack.back().vertices.end(), 0);
+
+    // member[v] == tag marks the part being split; level is -1 outside the current search
+    vector<int> member(n, -1);
+    vector<int> level(n, -1);
+    vector<int> queue;
+    queue.reserve(n);
+    int tag = 0;
+
+    auto degree = [&](int v) { return outer[v + 1] - outer[v]; };
+
+    // Breadth-first level structure over the tagged vertices reachable from root; leaves
+    // the visit order in queue and returns the depth of the last level
+    auto levels = [&](int root) {
+        for (int v : queue) level[v] = -1;
+        queue.clear();
+        queue.push_back(root);
+        level[root] = 0;
+        for (unsigned long q = 0; q < queue.size(); ++q) {
+            const int v = queue[q];
+            for (int p = outer[v]; p < outer[v + 1]; ++p) {
+                const int w = inner[p];
+                if (member[w] == tag && level[w] < 0) {
+                    level[w] = level[v] + 1;
+                    queue.push_back(w);
+                }
+            }
+        }
+        return level[queue.back()];
+    };
+
+    while (!stack.empty()) {
+        Part part = std::move(stack.back());
+        stack.pop_back();
+        const int size = part.vertices.size();
+
+        ++tag;
+        for (int v : part.vertices) member[v] = tag;
+
+        if (size <= LEAF_SIZE) {
+            orderLeaf(A, part.vertices, member, tag, perm.data() + part.first);
+            continue;
+        }
+
+        // Pseudo-peripheral root: restart from the lowest-degree vertex of the deepest level
+        // for as long as that makes the level structure deeper
+        int depth = levels(part.vertices[0]);
+        while (true) {
+            int candidate = queue.back();
+            for (int v : queue) {
+                if (level[v] == depth && degree(v) < degree(candidate)) candidate = v;
+            }
+            const int candidateDepth = levels(candidate);
+            if (candidateDepth <= depth) break;
+            depth = candidateDepth;
+        }
+
+        // A disconnected part needs no separator: split off the component just searched
+        if ((int) queue.size() < size) {
+            Part rest;
+            rest.first = part.first + queue.size();
+            for (int v : part.vertices) {
+                if (level[v] < 0) rest.vertices.push_back(v);
+            }
+            stack.push_back(std::move(rest));
+            stack.push_back({queue, part.first});
+            for (int v : queue) level[v] = -1;
+            queue.clear();
+            continue;
+        }
+
+        // Too shallow to cut, e.g. a small dense cluster
+        if (depth < 2) {
+            orderLeaf(A, part.vertices, member, tag, perm.data() + part.first);
+            for (int v : queue) level[v] = -1;
+            queue.clear();
+            continue;
+        }
+
+        // Cut at the smallest level that leaves between a third and two thirds of the vertices
+        // below it, or failing that at the one that splits them most evenly; never at the
+        // first or last level
+        vector<int> count(depth + 1, 0);
+        for (int v : queue) ++count[level[v]];
+        int middle = 0;
+        for (int l = 1, below = count[0]; l < depth; below += count[l++]) {
+            const bool balanced = below >= size / 3 && below + count[l] <= 2 * size / 3;
+            if (balanced && (middle == 0 || count[l] < count[middle])) middle = l;
+        }
+        if (middle == 0) {
+            middle = 1;
+            for (int below = count[0]; middle < depth - 1 && below + count[middle] < size / 2;) below += count[middle++];
+        }
+
+        // Only middle-level vertices touching the level above separate anything; the others
+        // join the lower half
+        Part lower, upper;
+        vector<int> separator;
+        for (int v : queue) {
+            if (level[v] < middle) {
+                lower.vertices.push_back(v);
+            } else if (level[v] > middle) {
+                upper.vertices.push_back(v);
+            } else {
+                bool touchesUpper = false;
+                for (int p = outer[v]; p < outer[v + 1] && !touchesUpper; ++p) {
+                    touchesUpper = member[inner[p]] == tag && level[inner[p]] == middle + 1;
+                }
+                (touchesUpper ? separator : lower.vertices).push_back(v);
+            }
+        }
+        for (int v : queue) level[v] = -1;
+        queue.clear();
+
+        lower.first = part.first;
+        upper.first = part.first + lower.vertices.size();
+        copy(separator.begin(), separator.end(), perm.begin() + upper.first + upper.vertices.size());
+        stack.push_back(std::move(upper));
+        stack.push_back(std::move(lower));
+    }
+}
+
+// Minimum degree ordering of the submatrix on the given vertices, the ones whose member
+// entry is tag, written to out
+void FillReduction::orderLeaf(const SparseMatrix<double> &A, const vector<int> &vertices, const vector<int> &member, int tag,
+                              int *out)
+{
+    const int size = vertices.size();
+    vector<int> sorted(vertices);
+    sort(sorted.begin(), sorted.end());
+
+    vector<Triplet<double>> entries;
+    for (int k = 0; k < size; ++k) {
+        for (int p = A.outerIndexPtr()[sorted[k]]; p < A.outerIndexPtr()[sorted[k] + 1]; ++p) {
+            const int i = A.innerIndexPtr()[p];
+            if (member[i] != tag) continue;
+            entries.emplace_back(lower_bound(sorted.begin(), sorted.end(), i) - sorted.begin(), k, 1.0);
+        }
+    }
+    SparseMatrix<double> block(size, size);
+    block.setFromTriplets(entries.begin(), entries.end());
+
+    PermutationMatrix<Dynamic, Dynamic, int> p;
+    AMDOrdering<int>()(block, p);
+    for (int k = 0; k < size; ++k) out[k] = sorted[p.indices()[k]];
+}
+
+const char *FillReduction::name(FillOrdering ordering)
+{
+    switch (ordering) {
+    case FillOrdering::IdentityOrdering:    return "identity";
+    case FillOrdering::MinimumDegree:       return "AMD";
+    case FillOrdering::ColumnMinimumDegree: return "COLAMD";
+    case FillOrdering::NestedDissection:    return "nested dissection";
+    }
+    return "";
+}
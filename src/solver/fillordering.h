@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#define EIGEN_DONT_VECTORIZE
+#define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
+#include "Eigen/Sparse"
+
+enum FillOrdering
+{
+    IdentityOrdering    = 0,
+    MinimumDegree       = 1,
+    ColumnMinimumDegree = 2,
+    NestedDissection    = 3
+};
+
+// Symmetric permutations applied before a sparse factorization to keep the fill-in of
+// its factor down. Orderings are written as perm[new] = old.
+class FillReduction
+{
+public:
+    // Ordering of a symmetric matrix, given with both triangles:
+    //  - identity: the matrix's own order, e.g. a mesh's vertex order
+    //  - approximate minimum degree on the pattern of A
+    //  - column approximate minimum degree, which orders for the fill of A^T A and so
+    //    overestimates the fill of a symmetric factor, but needs no symmetric pattern
+    //  - nested dissection, below
+    static void order(const Eigen::SparseMatrix<double> &A, FillOrdering ordering, std::vector<int> &perm);
+
+    // Recursively splits the graph of A by a vertex separator, the thinned middle level of
+    // a breadth-first level structure from a pseudo-peripheral vertex, and numbers both
+    // halves before the separator. Parts of at most LEAF_SIZE vertices are ordered by
+    // minimum degree.
+    static void nestedDissection(const Eigen::SparseMatrix<double> &A, std::vector<int> &perm);
+
+    static const char *name(FillOrdering ordering);
+
+private:
+    FillReduction();
+
+    static const int LEAF_SIZE = 512;
+
+    static void orderLeaf(const Eigen::SparseMatrix<double> &A, const std::vector<int> &vertices,
+                          const std::vector<int> &member, int tag, int *out);
+};
@@ -0,0 +1,115 @@
+#include "laplacian.h"
+#include "solver/threadpool.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace Eigen;
+
+Laplacian::Laplacian() {}
+
+// Absolute cotangent of the angle at a between edges ab and ac
+static double cotangent(const Vector3f &a, const Vector3f &b, const Vector3f &c)
+{
+    const Vector3d u = (b - a).cast<double>();
+    const Vector3d v = (c - a).cast<double>();
+    const double sine = u.cross(v).norm();
+    return abs(u.dot(v)) / max(sine, 1e-12);
+}
+
+void Laplacian::assemble(const vector<Vector3f> &vertices, const vector<Vector3i> &faces, SparseMatrix<double> &L, ThreadPool &pool)
+{
+    const int numVertices = vertices.size();
+    const int numFaces    = faces.size();
+
+    // Pass 1 (parallel over faces): half cotangent of each corner; corner k weights the opposite edge
+    vector<Vector3d> halfCot(numFaces);
+    pool.parallelFor(0, numFaces, [&](int begin, int end) {
+        for (int f = begin; f < end; ++f) {
+            const Vector3i &face = faces[f];
+            for (int k = 0; k < 3; ++k) {
+                halfCot[f][k] = 0.5 * cotangent(vertices[face[k]], vertices[face[(k + 1) % 3]], vertices[face[(k + 2) % 3]]);
+            }
+        }
+    });
+
+    // Vertex -> incident (face, corner) lists, in compressed form
+    vector<int> incidenceStart(numVertices + 1, 0);
+    for (const Vector3i &face : faces) {
+        for (int k = 0; k < 3; ++k) ++incidenceStart[face[k] + 1];
+    }
+    for (int i = 0; i < numVertices; ++i) incidenceStart[i + 1] += incidenceStart[i];
+
+    vector<int> incidence(incidenceStart[numVertices]);
+    {
+        vector<int> cursor(incidenceStart.begin(), incidenceStart.end() - 1);
+        for (int f = 0; f < numFaces; ++f) {
+            for (int k = 0; k < 3; ++k) incidence[cursor[faces[f][k]]++] = 3 * f + k;
+        }
+    }
+
+    // Pass 2 (parallel over vertices): sorted, unique one-ring of each vertex. Every
+    // incident corner contributes at most two neighbours, plus one slot for the diagonal.
+    vector<int> ring(2 * incidence.size() + numVertices);
+    vector<int> ringSize(numVertices);
+    pool.parallelFor(0, numVertices, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            int *out = ring.data() + 2 * incidenceStart[i] + i;
+            int count = 0;
+            for (int c = incidenceStart[i]; c < incidenceStart[i + 1]; ++c) {
+                const Vector3i &face = faces[incidence[c] / 3];
+                const int k = incidence[c] % 3;
+                out[count++] = face[(k + 1) % 3];
+                out[count++] = face[(k + 2) % 3];
+            }
+            out[count++] = i;
+            sort(out, out + count);
+            ringSize[i] = unique(out, out + count) - out;
+        }
+    });
+
+    // Column pointers straight from the one-ring sizes (diagonal included)
+    L.resize(numVertices, numVertices);
+    int *outer = L.outerIndexPtr();
+    outer[0] = 0;
+    for (int i = 0; i < numVertices; ++i) outer[i + 1] = outer[i] + ringSize[i];
+    L.resizeNonZeros(outer[numVertices]);
+
+    int    *inner  = L.innerIndexPtr();
+    double *values = L.valuePtr();
+
+    // Pass 3 (parallel over columns): each column gathers the weights of its own
+    // incident faces, so no two threads ever write the same entry
+    pool.parallelFor(0, numVertices, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const int *row = ring.data() + 2 * incidenceStart[i] + i;
+            int    *columnInner  = inner  + outer[i];
+            double *columnValues = values + outer[i];
+            const int size = ringSize[i];
+
+            copy(row, row + size, columnInner);
+            fill(columnValues, columnValues + size, 0.0);
+
+            auto slot = [&](int j) { return lower_bound(columnInner, columnInner + size, j) - columnInner; };
+
+            double diagonal = 0.0;
+            for (int c = incidenceStart[i]; c < incidenceStart[i + 1]; ++c) {
+                const int f = incidence[c] / 3;
+                const int k = incidence[c] % 3;
+                const Vector3i &face = faces[f];
+
+                // Edge (i, next) is opposite corner k + 2; edge (i, prev) is opposite corner k + 1
+                const int    next  = face[(k + 1) % 3];
+                const int    prev  = face[(k + 2) % 3];
+                const double wNext = halfCot[f][(k + 2) % 3];
+                const double wPrev = halfCot[f][(k + 1) % 3];
+
+                columnValues[slot(next)] -= wNext;
+                columnValues[slot(prev)] -= wPrev;
+                diagonal += wNext + wPrev;
+            }
+            columnValues[slot(i)] = diagonal;
+        }
+    });
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+#define EIGEN_DONT_VECTORIZE
+#define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
+#include "Eigen/Dense"
+#include "Eigen/Sparse"
+
+class ThreadPool;
+
+// n x 3 block of per-vertex coordinates, stored so that each vertex's x, y, z are adjacent
+typedef Eigen::Matrix<double, Eigen::Dynamic, 3, Eigen::RowMajor> MatrixX3dRow;
+
+// Builds the cotangent Laplacian used by ARAP: L_ij = -w_ij and L_ii = sum_j w_ij,
+// where w_ij = (|cot a_ij| + |cot b_ij|) / 2 over the two angles opposite edge ij.
+// The result is symmetric, so its compressed columns double as compressed rows.
+class Laplacian
+{
+public:
+    static void assemble(const std::vector<Eigen::Vector3f> &vertices,
+                         const std::vector<Eigen::Vector3i> &faces,
+                         Eigen::SparseMatrix<double> &L,
+                         ThreadPool &pool);
+
+private:
+    Laplacian();
+};
@@ -0,0 +1,305 @@
+#include "multigrid.h"
+#include "threadpool.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace Eigen;
+
+Multigrid::Multigrid() :
+    m_anchorsValid(false),
+    m_coarsestFactored(false),
+    m_cycle(MultigridCycle::VCycle),
+    m_tolerance(1e-6),
+    m_maxCycles(100),
+    m_lastCycles(0)
+{}
+
+void Multigrid::reset(const SparseMatrix<double> &L)
+{
+    m_L = L;
+    m_levels.clear();
+    m_levels.emplace_back();
+    m_levels.back().A = L;
+
+    // The hierarchy is chosen on the unanchored operators, so it does not depend on which
+    // vertices happen to be anchored
+    while (m_levels.back().A.rows() > COARSEST_SIZE) {
+        const SparseMatrix<double> &A = m_levels.back().A;
+        const SparseMatrix<double, RowMajor> P = smoothProlongation(A, coarsen(A));
+        if (P.cols() > MIN_REDUCTION * A.rows()) break;
+
+        const SparseMatrix<double> columnP = P;
+        const SparseMatrix<double> coarse  = SparseMatrix<double>(columnP.transpose()) * (A * columnP);
+
+        m_levels.back().P = P;
+        m_levels.emplace_back();
+        m_levels.back().A = coarse;
+    }
+
+    m_finestP = m_levels.front().P;
+    m_anchors.clear();
+    m_anchorsValid = false;
+}
+
+void Multigrid::setAnchors(const vector<int> &anchors)
+{
+    if (m_anchorsValid && anchors == m_anchors) return;
+
+    m_anchors = anchors;
+    buildOperators();
+    m_anchorsValid = true;
+}
+
+// Greedy maximal independent set in vertex order, which is deterministic and on a
+// triangle mesh keeps roughly a quarter of the vertices
+SparseMatrix<double, RowMajor> Multigrid::coarsen(const SparseMatrix<double> &A)
+{
+    const int n = A.rows();
+    vector<int>  coarseIndex(n, -1);
+    vector<char> excluded(n, 0);
+    int coarseCount = 0;
+
+    for (int i = 0; i < n; ++i) {
+        if (excluded[i]) continue;
+        coarseIndex[i] = coarseCount++;
+        for (SparseMatrix<double>::InnerIterator it(A, i); it; ++it) excluded[it.index()] = 1;
+    }
+
+    vector<Triplet<double>> triplets;
+    triplets.reserve(4 * n);
+
+    for (int i = 0; i < n; ++i) {
+        if (coarseIndex[i] >= 0) {
+            triplets.emplace_back(i, coarseIndex[i], 1.0);
+            continue;
+        }
+
+        // Maximality guarantees at least one kept neighbour; weigh them by their coupling,
+        // or equally if none of them is coupled with a negative entry
+        double total = 0;
+        int    count = 0;
+        for (SparseMatrix<double>::InnerIterator it(A, i); it; ++it) {
+            if (it.index() == i || coarseIndex[it.index()] < 0) continue;
+            total += max(-it.value(), 0.0);
+            ++count;
+        }
+
+        for (SparseMatrix<double>::InnerIterator it(A, i); it; ++it) {
+            if (it.index() == i || coarseIndex[it.index()] < 0) continue;
+            const double weight = total > 0 ? max(-it.value(), 0.0) / total : 1.0 / count;
+            if (weight > 0) triplets.emplace_back(i, coarseIndex[it.index()], weight);
+        }
+    }
+
+    SparseMatrix<double, RowMajor> P(n, coarseCount);
+    P.setFromTriplets(triplets.begin(), triplets.end());
+    return P;
+}
+
+// One damped Jacobi step on the columns of P, P - omega D^-1 A P. Plain interpolation from
+// the kept neighbours only follows smooth errors when the kept set is regular (as on a
+// subdivided mesh in subdivision order); in an order such as reverse Cuthill-McKee the
+// cycle count grows with the mesh without this. The step widens each row to the two-ring,
+// so tiny entries are dropped to keep the coarse operators sparse. Rows of A sum to zero,
+// so constants are still interpolated exactly before the drop.
+SparseMatrix<double, RowMajor> Multigrid::smoothProlongation(const SparseMatrix<double> &A, const SparseMatrix<double, RowMajor> &P)
+{
+    const VectorXd scale = PROLONGATION_DAMPING * A.diagonal().cwiseInverse();
+    const SparseMatrix<double, RowMajor> scaledA = scale.asDiagonal() * A;
+    const SparseMatrix<double, RowMajor> scaledAP = scaledA * P;
+
+    SparseMatrix<double, RowMajor> smoothed = P - scaledAP;
+    smoothed.prune(PROLONGATION_DROP, 1.0);
+    return smoothed;
+}
+
+void Multigrid::colorize(const SparseMatrix<double> &A, vector<int> &colorStart, vector<int> &colorRows)
+{
+    const int n = A.rows();
+    vector<int> color(n, -1);
+    vector<int> usedBy;
+    int colors = 0;
+
+    for (int i = 0; i < n; ++i) {
+        for (SparseMatrix<double>::InnerIterator it(A, i); it; ++it) {
+            const int c = color[it.index()];
+            if (c >= 0) usedBy[c] = i;
+        }
+
+        int c = 0;
+        while (c < colors && usedBy[c] == i) ++c;
+        if (c == colors) {
+            usedBy.push_back(-1);
+            ++colors;
+        }
+        color[i] = c;
+    }
+
+    colorStart.assign(colors + 1, 0);
+    for (int i = 0; i < n; ++i) ++colorStart[color[i] + 1];
+    for (int c = 0; c < colors; ++c) colorStart[c + 1] += colorStart[c];
+
+    colorRows.resize(n);
+    vector<int> fill(colorStart.begin(), colorStart.end() - 1);
+    for (int i = 0; i < n; ++i) colorRows[fill[color[i]]++] = i;
+}
+
+void Multigrid::buildOperators()
+{
+    const int n = m_L.rows();
+    vector<char> anchored(n, 0);
+    for (int a : m_anchors) anchored[a] = 1;
+
+    // Finest operator: anchored rows and columns become identity rows, as in FactorCache
+    Level &finest = m_levels.front();
+    finest.A = m_L;
+    for (int j = 0; j < n; ++j) {
+        for (SparseMatrix<double>::InnerIterator it(finest.A, j); it; ++it) {
+            if (anchored[j] || anchored[it.index()]) it.valueRef() = it.index() == j ? 1.0 : 0.0;
+        }
+    }
+
+    if (m_levels.size() > 1) {
+        finest.P = m_finestP;
+        for (int a : m_anchors) {
+            for (SparseMatrix<double, RowMajor>::InnerIterator it(finest.P, a); it; ++it) it.valueRef() = 0;
+        }
+        finest.P.prune(0.0);
+    }
+
+    for (unsigned long l = 0; l + 1 < m_levels.size(); ++l) {
+        Level &fine = m_levels[l];
+        fine.R = fine.P.transpose();
+
+        const SparseMatrix<double> columnP = fine.P;
+        SparseMatrix<double> coarse = (SparseMatrix<double>(fine.R) * (fine.A * columnP)).pruned();
+
+        // A coarse vertex whose support is entirely anchored has an empty row; an identity
+        // row keeps the operator invertible and its correction at zero
+        for (int c = 0; c < coarse.rows(); ++c) {
+            if (coarse.coeff(c, c) == 0) coarse.coeffRef(c, c) = 1.0;
+        }
+        coarse.makeCompressed();
+
+        m_levels[l + 1].A = coarse;
+    }
+
+    for (Level &level : m_levels) {
+        const int size = level.A.rows();
+        level.inverseDiagonal = level.A.diagonal().cwiseInverse();
+        colorize(level.A, level.colorStart, level.colorRows);
+        level.b.setZero(size, 3);
+        level.x.setZero(size, 3);
+        level.r.setZero(size, 3);
+    }
+
+    m_coarsest.analyzePattern(m_levels.back().A);
+    m_coarsestFactored = m_coarsest.factorize(m_levels.back().A);
+}
+
+void Multigrid::smooth(Level &level, const MatrixX3dRow &b, MatrixX3dRow &x, bool backwards, ThreadPool &pool) const
+{
+    const int colors = level.colorStart.size() - 1;
+
+    for (int sweep = 0; sweep < SMOOTHING_SWEEPS; ++sweep) {
+        for (int step = 0; step < colors; ++step) {
+            const int c = backwards ? colors - 1 - step : step;
+
+            pool.parallelFor(level.colorStart[c], level.colorStart[c + 1], [&](int begin, int end) {
+                for (int k = begin; k < end; ++k) {
+                    const int i = level.colorRows[k];
+                    RowVector3d sum = b.row(i);
+                    for (SparseMatrix<double>::InnerIterator it(level.A, i); it; ++it) {
+                        if (it.index() != i) sum -= it.value() * x.row(it.index());
+                    }
+                    x.row(i) = sum * level.inverseDiagonal[i];
+                }
+            });
+        }
+    }
+}
+
+void Multigrid::residual(const Level &level, const MatrixX3dRow &b, const MatrixX3dRow &x, MatrixX3dRow &r, ThreadPool &pool) const
+{
+    pool.parallelFor(0, level.A.outerSize(), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            RowVector3d sum = b.row(i);
+            for (SparseMatrix<double>::InnerIterator it(level.A, i); it; ++it) sum -= it.value() * x.row(it.index());
+            r.row(i) = sum;
+        }
+    });
+}
+
+void Multigrid::cycle(int index, const MatrixX3dRow &b, MatrixX3dRow &x, ThreadPool &pool)
+{
+    Level &level = m_levels[index];
+    const int last = m_levels.size() - 1;
+
+    // Without anchors L is singular and the factorization fails; smoothing at least keeps
+    // the correction bounded
+    if (index == last && m_coarsestFactored) {
+        x = b;
+        m_coarsest.solveInPlace(x);
+        return;
+    }
+    if (index == last) {
+        smooth(level, b, x, false, pool);
+        smooth(level, b, x, true, pool);
+        return;
+    }
+
+    smooth(level, b, x, false, pool);
+    residual(level, b, x, level.r, pool);
+
+    Level &coarse = m_levels[index + 1];
+    pool.parallelFor(0, level.R.outerSize(), [&](int begin, int end) {
+        for (int c = begin; c < end; ++c) {
+            RowVector3d sum = RowVector3d::Zero();
+            for (SparseMatrix<double, RowMajor>::InnerIterator it(level.R, c); it; ++it) sum += it.value() * level.r.row(it.index());
+            coarse.b.row(c) = sum;
+        }
+    });
+    coarse.x.setZero();
+
+    // A W-cycle visits every coarser level (but the exactly solved one) twice
+    const int visits = m_cycle == MultigridCycle::WCycle && index + 1 < last ? 2 : 1;
+    for (int visit = 0; visit < visits; ++visit) cycle(index + 1, coarse.b, coarse.x, pool);
+
+    pool.parallelFor(0, level.P.outerSize(), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            for (SparseMatrix<double, RowMajor>::InnerIterator it(level.P, i); it; ++it) x.row(i) += it.value() * coarse.x.row(it.index());
+        }
+    });
+
+    smooth(level, b, x, true, pool);
+}
+
+int Multigrid::solve(const MatrixX3dRow &rhs, MatrixX3dRow &x, ThreadPool &pool)
+{
+    Level &finest = m_levels.front();
+    const RowVector3d target = (m_tolerance * m_tolerance) * rhs.colwise().squaredNorm();
+
+    for (int a : m_anchors) x.row(a) = rhs.row(a);
+
+    residual(finest, rhs, x, finest.r, pool);
+    RowVector3d rNorm2 = finest.r.colwise().squaredNorm();
+
+    int cycles = 0;
+    while (cycles < m_maxCycles && (rNorm2.array() > target.array()).any()) {
+        cycle(0, rhs, x, pool);
+        ++cycles;
+
+        residual(finest, rhs, x, finest.r, pool);
+        rNorm2 = finest.r.colwise().squaredNorm();
+    }
+
+    m_lastCycles = cycles;
+    return cycles;
+}
+
+void Multigrid::precondition(const MatrixX3dRow &r, MatrixX3dRow &z, ThreadPool &pool)
+{
+    z.setZero(r.rows(), 3);
+    cycle(0, r, z, pool);
+}
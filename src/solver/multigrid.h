@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vector>
+
+#define EIGEN_DONT_VECTORIZE
+#define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
+#include "Eigen/Sparse"
+
+#include "solver/laplacian.h"
+#include "solver/sparseldlt.h"
+
+class ThreadPool;
+
+enum MultigridCycle
+{
+    VCycle = 0,
+    WCycle = 1
+};
+
+// Multigrid for the anchored Laplacian system of the global step, with the same
+// right-hand side as FactorCache and PCGSolver.
+//
+// The hierarchy is built once per mesh from the mesh itself: each coarser level keeps a
+// maximal independent set of the vertices of the finer one, and every dropped vertex is
+// interpolated from its kept neighbours in proportion to the edge weights. That
+// interpolation is then smoothed by one damped Jacobi step, so it does not depend on how
+// regular the kept set came out. Coarse operators are the Galerkin products P^T A P,
+// redone when the anchors change (the anchored rows of the finest prolongation are
+// cleared so corrections never move them), and the coarsest level is solved exactly
+// with SparseLDLT.
+//
+// The cost of a solve is not quite linear in the mesh size: on the bunny subdivided up to
+// 557k vertices (arap-bench), PCG iterations still grow from 5 to 9, and each iteration
+// costs half again as much per vertex once the levels no longer fit in cache.
+//
+// Smoothing is Gauss-Seidel over a greedy graph coloring of each level: rows of one color
+// share no entries, so each color is updated in parallel. Colors are swept forwards before
+// the coarse correction and backwards after it, which keeps a cycle symmetric so it can
+// also precondition PCG.
+class Multigrid
+{
+public:
+    Multigrid();
+
+    // Builds the level hierarchy of L and drops the anchors
+    void reset(const Eigen::SparseMatrix<double> &L);
+
+    // Sets the (sorted) anchor set, redoing the coarse operators only if it changed
+    void setAnchors(const std::vector<int> &anchors);
+
+    void setCycle(MultigridCycle cycle) { m_cycle = cycle; }
+    MultigridCycle getCycle() const { return m_cycle; }
+
+    // Stops once every column satisfies |r| <= tolerance |b|, or after maxCycles
+    void setTolerance(double tolerance) { m_tolerance = tolerance; }
+    void setMaxCycles(int cycles) { m_maxCycles = cycles; }
+
+    // Cycles on the anchored system from the initial guess x; returns the cycles taken
+    int solve(const MatrixX3dRow &rhs, MatrixX3dRow &x, ThreadPool &pool);
+
+    // One cycle from a zero initial guess, i.e. an approximation of A^-1 r
+    void precondition(const MatrixX3dRow &r, MatrixX3dRow &z, ThreadPool &pool);
+
+    int getLevels()     const { return m_levels.size(); }
+    int getLastCycles() const { return m_lastCycles; }
+    int getLevelSize(int level) const { return m_levels[level].A.rows(); }
+
+private:
+    // Levels stop coarsening at this size, or when a level would keep most of its vertices
+    static const int        COARSEST_SIZE    = 512;
+    static constexpr double MIN_REDUCTION    = 0.8;
+    static const int        SMOOTHING_SWEEPS = 2;
+
+    // Jacobi damping of the prolongation, and the size below which its entries are dropped
+    static constexpr double PROLONGATION_DAMPING = 2.0 / 3.0;
+    static constexpr double PROLONGATION_DROP    = 1e-3;
+
+    struct Level
+    {
+        // Operator of this level, symmetric so its columns double as its rows
+        Eigen::SparseMatrix<double> A;
+        Eigen::VectorXd             inverseDiagonal;
+
+        // Interpolation from the next coarser level, and its transpose, row-major so both
+        // products parallelize over output rows
+        Eigen::SparseMatrix<double, Eigen::RowMajor> P;
+        Eigen::SparseMatrix<double, Eigen::RowMajor> R;
+
+        // Rows grouped by color: rows of color c are colorRows[colorStart[c] .. colorStart[c + 1])
+        std::vector<int> colorStart;
+        std::vector<int> colorRows;
+
+        MatrixX3dRow b;
+        MatrixX3dRow x;
+        MatrixX3dRow r;
+    };
+
+    std::vector<Level> m_levels;
+
+    // Level 0 operator without anchors, and the unmasked finest prolongation
+    Eigen::SparseMatrix<double>                  m_L;
+    Eigen::SparseMatrix<double, Eigen::RowMajor> m_finestP;
+
+    std::vector<int> m_anchors;
+    bool             m_anchorsValid;
+    SparseLDLT       m_coarsest;
+    bool             m_coarsestFactored;
+
+    MultigridCycle m_cycle;
+    double         m_tolerance;
+    int            m_maxCycles;
+    int            m_lastCycles;
+
+    static Eigen::SparseMatrix<double, Eigen::RowMajor> coarsen(const Eigen::SparseMatrix<double> &A);
+    static Eigen::SparseMatrix<double, Eigen::RowMajor> smoothProlongation(const Eigen::SparseMatrix<double> &A,
+                                                                           const Eigen::SparseMatrix<double, Eigen::RowMajor> &P);
+    static void colorize(const Eigen::SparseMatrix<double> &A, std::vector<int> &colorStart, std::vector<int> &colorRows);
+
+    void buildOperators();
+    void smooth(Level &level, const MatrixX3dRow &b, MatrixX3dRow &x, bool backwards, ThreadPool &pool) const;
+    void residual(const Level &level, const MatrixX3dRow &b, const MatrixX3dRow &x, MatrixX3dRow &r, ThreadPool &pool) const;
+    void cycle(int index, const MatrixX3dRow &b, MatrixX3dRow &x, ThreadPool &pool);
+};
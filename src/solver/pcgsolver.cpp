@@ -0,0 +1,296 @@
+#include "pcgsolver.h"
+#include "multigrid.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace Eigen;
+
+PCGSolver::PCGSolver() :
+    m_preconditioner(Preconditioner::JacobiScaling),
+    m_multigrid(nullptr),
+    m_tolerance(1e-6),
+    m_maxIterations(1000),
+    m_lastIterations(0),
+    m_icValid(false)
+{}
+
+void PCGSolver::reset(const SparseMatrix<double> &L)
+{
+    const int n = L.cols();
+
+    m_weights.clear();
+    m_diagonal.assign(n, 0.0);
+    m_incidentStart.assign(n + 1, 0);
+
+    // L is symmetric with sorted columns: the strictly lower part lists every edge once,
+    // and each column of the full matrix is already the sorted one-ring of its vertex
+    for (int j = 0; j < n; ++j) {
+        for (SparseMatrix<double>::InnerIterator it(L, j); it; ++it) {
+            const int i = it.index();
+            if (i == j) {
+                m_diagonal[j] = it.value();
+            } else {
+                ++m_incidentStart[j + 1];
+                if (i > j) m_weights.push_back(-it.value());
+            }
+        }
+    }
+
+    for (int i = 0; i < n; ++i) m_incidentStart[i + 1] += m_incidentStart[i];
+
+    // Edge (j, i) with i > j was numbered when column j was scanned, so reaching it from
+    // i means looking up the position of i in j's list, which the fill pointer tracks
+    m_neighbors.resize(m_incidentStart[n]);
+    m_incident.resize(m_incidentStart[n]);
+    vector<int> fill(m_incidentStart.begin(), m_incidentStart.end() - 1);
+    int edge = 0;
+    for (int j = 0; j < n; ++j) {
+        for (SparseMatrix<double>::InnerIterator it(L, j); it; ++it) {
+            const int i = it.index();
+            if (i <= j) continue;
+            m_neighbors[fill[j]] = i;
+            m_incident[fill[j]++] = edge;
+            m_neighbors[fill[i]] = j;
+            m_incident[fill[i]++] = edge;
+            ++edge;
+        }
+    }
+
+    m_anchors.clear();
+    m_anchored.assign(n, 0);
+    m_icValid = m_preconditioner == Preconditioner::IncompleteCholesky0 && factorIncomplete();
+
+    m_r.resize(n, 3);
+    m_z.resize(n, 3);
+    m_p.resize(n, 3);
+    m_q.resize(n, 3);
+    m_partials.assign(3 * ((n + REDUCTION_BLOCK - 1) / REDUCTION_BLOCK), 0.0);
+}
+
+void PCGSolver::setAnchors(const vector<int> &anchors)
+{
+    if (anchors == m_anchors) return;
+
+    for (int a : m_anchors) m_anchored[a] = 0;
+    m_anchors = anchors;
+    for (int a : m_anchors) m_anchored[a] = 1;
+
+    m_icValid = false;
+    if (m_preconditioner == Preconditioner::IncompleteCholesky0) m_icValid = factorIncomplete();
+}
+
+void PCGSolver::setPreconditioner(Preconditioner preconditioner)
+{
+    m_preconditioner = preconditioner;
+    if (m_preconditioner == Preconditioner::IncompleteCholesky0 && !m_icValid) m_icValid = factorIncomplete();
+}
+
+// y = A x, where A is L with anchored rows replaced by identity rows and anchored columns
+// dropped. Dropping the columns is left to the caller, by passing an x that is zero on
+// every anchored row; the search directions of CG always are.
+void PCGSolver::apply(const MatrixX3dRow &x, MatrixX3dRow &y, ThreadPool &pool) const
+{
+    pool.parallelFor(0, m_diagonal.size(), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            RowVector3d sum = m_diagonal[i] * x.row(i);
+            for (int k = m_incidentStart[i]; k < m_incidentStart[i + 1]; ++k) sum -= m_weights[m_incident[k]] * x.row(m_neighbors[k]);
+            y.row(i) = m_anchored[i] ? RowVector3d(x.row(i)) : sum;
+        }
+    });
+}
+
+void PCGSolver::couplingProduct(const MatrixX3dRow &positions, MatrixX3dRow &out, ThreadPool &pool) const
+{
+    out.setZero(positions.rows(), 3);
+    if (m_anchors.empty()) return;
+
+    pool.parallelFor(0, m_diagonal.size(), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            if (m_anchored[i]) continue;
+
+            for (int k = m_incidentStart[i]; k < m_incidentStart[i + 1]; ++k) {
+                const int j = m_neighbors[k];
+                if (m_anchored[j]) out.row(i) -= m_weights[m_incident[k]] * positions.row(j);
+            }
+        }
+    });
+}
+
+void PCGSolver::precondition(const MatrixX3dRow &r, MatrixX3dRow &z, ThreadPool &pool)
+{
+    const int n = m_diagonal.size();
+
+    if (m_preconditioner == Preconditioner::MultigridCycles && m_multigrid) {
+        m_multigrid->precondition(r, z, pool);
+        return;
+    }
+
+    if (m_preconditioner == Preconditioner::IncompleteCholesky0 && m_icValid) {
+        // Forward then backward substitution with the IC(0) factor C (A ~ C C^T), whose
+        // strictly lower entries sit on the edges; both sweeps are inherently serial
+        for (int i = 0; i < n; ++i) {
+            RowVector3d sum = r.row(i);
+            for (int k = m_incidentStart[i]; k < m_incidentStart[i + 1]; ++k) {
+                const int j = m_neighbors[k];
+                if (j >= i) break;
+                sum -= m_icEdge[m_incident[k]] * z.row(j);
+            }
+            z.row(i) = sum / m_icDiagonal[i];
+        }
+        for (int i = n - 1; i >= 0; --i) {
+            RowVector3d sum = z.row(i);
+            for (int k = m_incidentStart[i + 1] - 1; k >= m_incidentStart[i]; --k) {
+                const int j = m_neighbors[k];
+                if (j <= i) break;
+                sum -= m_icEdge[m_incident[k]] * z.row(j);
+            }
+            z.row(i) = sum / m_icDiagonal[i];
+        }
+        return;
+    }
+
+    pool.parallelFor(0, n, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) z.row(i) = m_anchored[i] ? r.row(i) : RowVector3d(r.row(i) / m_diagonal[i]);
+    });
+}
+
+Vector3d PCGSolver::dot(const MatrixX3dRow &a, const MatrixX3dRow &b, ThreadPool &pool)
+{
+    const int n      = a.rows();
+    const int blocks = (n + REDUCTION_BLOCK - 1) / REDUCTION_BLOCK;
+
+    pool.parallelFor(0, blocks, [&](int begin, int end) {
+        for (int block = begin; block < end; ++block) {
+            const int first = block * REDUCTION_BLOCK;
+            const int count = min(REDUCTION_BLOCK, n - first);
+            const Vector3d partial = (a.middleRows(first, count).cwiseProduct(b.middleRows(first, count))).colwise().sum().transpose();
+            for (int c = 0; c < 3; ++c) m_partials[3 * block + c] = partial[c];
+        }
+    }, 1);
+
+    Vector3d sum = Vector3d::Zero();
+    for (int block = 0; block < blocks; ++block) {
+        for (int c = 0; c < 3; ++c) sum[c] += m_partials[3 * block + c];
+    }
+    return sum;
+}
+
+int PCGSolver::solve(const MatrixX3dRow &rhs, MatrixX3dRow &x, ThreadPool &pool)
+{
+    const Vector3d bNorm2 = dot(rhs, rhs, pool);
+    const Vector3d target = (m_tolerance * m_tolerance) * bNorm2;
+
+    // r = b - A x over the free rows; the anchored rows of x are exact once set from b
+    for (int a : m_anchors) x.row(a).setZero();
+    apply(x, m_q, pool);
+    m_r = rhs - m_q;
+    for (int a : m_anchors) {
+        x.row(a) = rhs.row(a);
+        m_r.row(a).setZero();
+    }
+
+    Vector3d rNorm2 = dot(m_r, m_r, pool);
+
+    precondition(m_r, m_z, pool);
+    m_p = m_z;
+    Vector3d rz = dot(m_r, m_z, pool);
+
+    int iteration = 0;
+    while (iteration < m_maxIterations && (rNorm2.array() > target.array()).any()) {
+        apply(m_p, m_q, pool);
+        const Vector3d pq = dot(m_p, m_q, pool);
+
+        // A column that has converged keeps a zero step, so the others can carry on
+        Vector3d alpha = Vector3d::Zero();
+        for (int c = 0; c < 3; ++c) {
+            if (rNorm2[c] > target[c] && pq[c] > 0) alpha[c] = rz[c] / pq[c];
+        }
+
+        pool.parallelFor(0, x.rows(), [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                x.row(i)   += m_p.row(i).cwiseProduct(alpha.transpose());
+                m_r.row(i) -= m_q.row(i).cwiseProduct(alpha.transpose());
+            }
+        });
+
+        precondition(m_r, m_z, pool);
+        const Vector3d rzNext = dot(m_r, m_z, pool);
+        rNorm2 = dot(m_r, m_r, pool);
+
+        Vector3d beta = Vector3d::Zero();
+        for (int c = 0; c < 3; ++c) {
+            if (rz[c] > 0) beta[c] = rzNext[c] / rz[c];
+        }
+        rz = rzNext;
+
+        pool.parallelFor(0, x.rows(), [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) m_p.row(i) = m_z.row(i) + m_p.row(i).cwiseProduct(beta.transpose());
+        });
+
+        ++iteration;
+    }
+
+    m_lastIterations = iteration;
+    return iteration;
+}
+
+// IC(0): the Cholesky recurrence restricted to the edges, c_ij = (a_ij - sum_k c_ik c_jk) / c_jj
+// over common earlier neighbours k. The anchored Laplacian is an M-matrix (all weights are
+// non-negative), for which this never breaks down in exact arithmetic; a non-positive
+// pivot from round-off makes the caller fall back to Jacobi.
+bool PCGSolver::factorIncomplete()
+{
+    const int n = m_diagonal.size();
+    m_icEdge.assign(m_weights.size(), 0.0);
+    m_icDiagonal.assign(n, 1.0);
+
+    for (int i = 0; i < n; ++i) {
+        if (m_anchored[i]) continue;
+
+        double diagonal = m_diagonal[i];
+        for (int k = m_incidentStart[i]; k < m_incidentStart[i + 1]; ++k) {
+            const int e = m_incident[k];
+            const int j = m_neighbors[k];
+            if (j >= i) break;
+            if (m_anchored[j]) continue;
+
+            // Merge the two sorted incidence lists over neighbours below j
+            double value = -m_weights[e];
+            int    a     = m_incidentStart[i];
+            int    b     = m_incidentStart[j];
+            while (a < k && b < m_incidentStart[j + 1]) {
+                const int va = m_neighbors[a];
+                const int vb = m_neighbors[b];
+                if (vb >= j) break;
+                if (va < vb) {
+                    ++a;
+                } else if (vb < va) {
+                    ++b;
+                } else {
+                    value -= m_icEdge[m_incident[a]] * m_icEdge[m_incident[b]];
+                    ++a;
+                    ++b;
+                }
+            }
+
+            m_icEdge[e] = value / m_icDiagonal[j];
+            diagonal   -= m_icEdge[e] * m_icEdge[e];
+        }
+
+        if (diagonal <= 0) return false;
+        m_icDiagonal[i] = sqrt(diagonal);
+    }
+    return true;
+}
+
+long PCGSolver::memoryUsage() const
+{
+    const long n = m_diagonal.size();
+    const long e = m_weights.size();
+    long bytes = e * sizeof(double) + 2 * m_incident.size() * sizeof(int) + (n + 1) * sizeof(int) + n * (sizeof(double) + 1);
+    if (m_icValid) bytes += (e + n) * sizeof(double);
+    return bytes + 4 * n * 3 * sizeof(double);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vector>
+
+#define EIGEN_DONT_VECTORIZE
+#define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
+#include "Eigen/Sparse"
+
+#include "solver/laplacian.h"
+
+class Multigrid;
+class ThreadPool;
+
+enum Preconditioner
+{
+    JacobiScaling       = 0,
+    IncompleteCholesky0 = 1,
+    MultigridCycles     = 2
+};
+
+// Matrix-free preconditioned conjugate gradients (PCG) for the anchored Laplacian system of the
+// global step, for meshes whose factor would not fit in memory. L is never stored as a
+// matrix: each undirected edge keeps one weight, each vertex lists its incident edges,
+// and L x is applied row by row from those. Anchored rows act as identity rows with
+// their columns removed, exactly as in FactorCache, so both backends take the same
+// right-hand side.
+//
+// The x, y and z columns are solved together, each with its own step lengths, starting
+// from whatever the caller passes in (the previous positions, which a drag barely moves).
+class PCGSolver
+{
+public:
+    PCGSolver();
+
+    // Extracts the edge weights of L and drops the anchors
+    void reset(const Eigen::SparseMatrix<double> &L);
+
+    // Sets the (sorted) anchor set, rebuilding the preconditioner only if it changed
+    void setAnchors(const std::vector<int> &anchors);
+
+    void setPreconditioner(Preconditioner preconditioner);
+    Preconditioner getPreconditioner() const { return m_preconditioner; }
+
+    // Hierarchy used by the MultigridCycles preconditioner, one cycle per application.
+    // It must be kept on the same anchors by the caller.
+    void setMultigrid(Multigrid *multigrid) { m_multigrid = multigrid; }
+
+    // Stops once every column satisfies |r| <= tolerance |b|, or after maxIterations
+    void setTolerance(double tolerance) { m_tolerance = tolerance; }
+    void setMaxIterations(int iterations) { m_maxIterations = iterations; }
+
+    // L_fc x_c for the current anchors, read from the anchored rows of positions; the
+    // same product as FactorCache::getCoupling() times the anchored targets
+    void couplingProduct(const MatrixX3dRow &positions, MatrixX3dRow &out, ThreadPool &pool) const;
+
+    // Solves the anchored system for rhs with x as the initial guess; returns the
+    // number of iterations taken
+    int solve(const MatrixX3dRow &rhs, MatrixX3dRow &x, ThreadPool &pool);
+
+    int getLastIterations() const { return m_lastIterations; }
+
+    // Bytes held for the operator and preconditioner, for comparison with a factor
+    long memoryUsage() const;
+
+private:
+    // Rows per block of the reductions; partial sums are per fixed block so the result
+    // does not depend on how the pool split the loop
+    static const int REDUCTION_BLOCK = 1024;
+
+    // One weight w_ij = -L_ij per undirected edge
+    std::vector<double> m_weights;
+
+    // Incident edges per vertex, sorted by neighbour: slots m_incidentStart[i] ..
+    // m_incidentStart[i + 1] hold the neighbour and the edge it is reached through
+    std::vector<int>    m_incidentStart;
+    std::vector<int>    m_neighbors;
+    std::vector<int>    m_incident;
+    std::vector<double> m_diagonal;
+
+    std::vector<int>  m_anchors;
+    std::vector<char> m_anchored;
+
+    Preconditioner m_preconditioner;
+    Multigrid     *m_multigrid;
+    double         m_tolerance;
+    int            m_maxIterations;
+    int            m_lastIterations;
+
+    // IC(0) of the anchored matrix: one off-diagonal value per edge, plus the diagonal
+    std::vector<double> m_icEdge;
+    std::vector<double> m_icDiagonal;
+    bool                m_icValid;
+
+    MatrixX3dRow        m_r, m_z, m_p, m_q;
+    std::vector<double> m_partials;
+
+    void apply(const MatrixX3dRow &x, MatrixX3dRow &y, ThreadPool &pool) const;
+    void precondition(const MatrixX3dRow &r, MatrixX3dRow &z, ThreadPool &pool);
+    Eigen::Vector3d dot(const MatrixX3dRow &a, const MatrixX3dRow &b, ThreadPool &pool);
+    bool factorIncomplete();
+};
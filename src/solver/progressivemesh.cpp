@@ -0,0 +1,368 @@
+#include "progressivemesh.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+using namespace std;
+using namespace Eigen;
+
+namespace {
+
+struct Collapse
+{
+    double cost;
+    int    from;
+    int    to;
+    int    fromStamp;
+    int    toStamp;
+    Vector3d position;
+
+    bool operator<(const Collapse &other) const { return cost > other.cost; }
+};
+
+Matrix4d planeQuadric(const Vector3d &normal, const Vector3d &point, double weight)
+{
+    Vector4d plane;
+    plane << normal, -normal.dot(point);
+    return weight * plane * plane.transpose();
+}
+
+// Position minimizing v^T Q v, or the best of the endpoints and midpoint when Q is
+// (nearly) singular, as for a flat neighbourhood
+Vector3d optimalPosition(const Matrix4d &Q, const Vector3d &a, const Vector3d &b, double &cost)
+{
+    const Matrix3d A = Q.topLeftCorner<3, 3>();
+    const Vector3d rhs = -Q.topRightCorner<3, 1>();
+
+    auto evaluate = [&](const Vector3d &v) {
+        Vector4d h;
+        h << v, 1.0;
+        return h.dot(Q * h);
+    };
+
+    if (std::abs(A.determinant()) > 1e-12 * std::max(1.0, A.squaredNorm() * A.norm())) {
+        const Vector3d v = A.ldlt().solve(rhs);
+        if (v.allFinite() && (v - 0.5 * (a + b)).norm() < 2.0 * (a - b).norm()) {
+            cost = evaluate(v);
+            return v;
+        }
+    }
+
+    const Vector3d candidates[3] = { a, b, 0.5 * (a + b) };
+    Vector3d best = candidates[2];
+    cost = numeric_limits<double>::infinity();
+    for (const Vector3d &v : candidates) {
+        const double c = evaluate(v);
+        if (c < cost) {
+            cost = c;
+            best = v;
+        }
+    }
+    return best;
+}
+
+// Closest point on triangle abc to p, as barycentric coordinates (Ericson, Real-Time
+// Collision Detection, 5.1.5)
+Vector3d closestBarycentric(const Vector3d &p, const Vector3d &a, const Vector3d &b, const Vector3d &c)
+{
+    const Vector3d ab = b - a, ac = c - a, ap = p - a;
+    const double d1 = ab.dot(ap), d2 = ac.dot(ap);
+    if (d1 <= 0 && d2 <= 0) return Vector3d(1, 0, 0);
+
+    const Vector3d bp = p - b;
+    const double d3 = ab.dot(bp), d4 = ac.dot(bp);
+    if (d3 >= 0 && d4 <= d3) return Vector3d(0, 1, 0);
+
+    const double vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+        const double v = d1 / (d1 - d3);
+        return Vector3d(1 - v, v, 0);
+    }
+
+    const Vector3d cp = p - c;
+    const double d5 = ab.dot(cp), d6 = ac.dot(cp);
+    if (d6 >= 0 && d5 <= d6) return Vector3d(0, 0, 1);
+
+    const double vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+        const double w = d2 / (d2 - d6);
+        return Vector3d(1 - w, 0, w);
+    }
+
+    const double va = d3 * d6 - d5 * d4;
+    if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+        const double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        return Vector3d(0, 1 - w, w);
+    }
+
+    const double denominator = 1.0 / (va + vb + vc);
+    const double v = vb * denominator, w = vc * denominator;
+    return Vector3d(1 - v - w, v, w);
+}
+
+}
+
+ProgressiveMesh::ProgressiveMesh() :
+    m_targetVertices(0)
+{}
+
+void ProgressiveMesh::build(const vector<Vector3f> &vertices, const vector<Vector3i> &triangles,
+                            int targetVertices, ThreadPool &pool)
+{
+    const int n = vertices.size();
+    m_targetVertices = targetVertices;
+
+    vector<Vector3d> position(n);
+    for (int i = 0; i < n; ++i) position[i] = vertices[i].cast<double>();
+
+    vector<Vector3i>    faces = triangles;
+    vector<char>        faceAlive(faces.size(), 1);
+    vector<vector<int>> incident(n);
+    for (unsigned long f = 0; f < faces.size(); ++f) {
+        for (int k = 0; k < 3; ++k) incident[faces[f][k]].push_back(f);
+    }
+
+    auto faceNormal = [&](const Vector3i &face, int moved, const Vector3d &movedTo) {
+        Vector3d p[3];
+        for (int k = 0; k < 3; ++k) p[k] = face[k] == moved ? movedTo : position[face[k]];
+        return Vector3d((p[1] - p[0]).cross(p[2] - p[0]));
+    };
+
+    // Area-weighted face planes, plus perpendicular planes along boundary edges
+    vector<Matrix4d> quadric(n, Matrix4d::Zero());
+    for (unsigned long f = 0; f < faces.size(); ++f) {
+        const Vector3d normal = faceNormal(faces[f], -1, Vector3d::Zero());
+        const double   area   = 0.5 * normal.norm();
+        if (area <= 0) continue;
+
+        const Matrix4d K = planeQuadric(normal.normalized(), position[faces[f][0]], area);
+        for (int k = 0; k < 3; ++k) quadric[faces[f][k]] += K;
+
+        for (int k = 0; k < 3; ++k) {
+            const int a = faces[f][k], b = faces[f][(k + 1) % 3];
+            int shared = 0;
+            for (int g : incident[a]) {
+                const Vector3i &other = faces[g];
+                if (other[0] == b || other[1] == b || other[2] == b) ++shared;
+            }
+            if (shared != 1) continue;
+
+            const Vector3d edge = position[b] - position[a];
+            const Vector3d side = edge.cross(normal).normalized();
+            const Matrix4d B = planeQuadric(side, position[a], BOUNDARY_WEIGHT * edge.squaredNorm());
+            quadric[a] += B;
+            quadric[b] += B;
+        }
+    }
+
+    vector<int> parent(n), stamp(n, 0);
+    vector<char> alive(n, 1);
+    for (int i = 0; i < n; ++i) parent[i] = i;
+
+    auto neighbors = [&](int v, vector<int> &out) {
+        out.clear();
+        for (int f : incident[v]) {
+            for (int k = 0; k < 3; ++k) {
+                if (faces[f][k] != v) out.push_back(faces[f][k]);
+            }
+        }
+        sort(out.begin(), out.end());
+        out.erase(unique(out.begin(), out.end()), out.end());
+    };
+
+    priority_queue<Collapse> heap;
+    auto push = [&](int a, int b) {
+        Collapse c;
+        c.position  = optimalPosition(quadric[a] + quadric[b], position[a], position[b], c.cost);
+        c.from      = b;
+        c.to        = a;
+        c.fromStamp = stamp[b];
+        c.toStamp   = stamp[a];
+        heap.push(c);
+    };
+
+    vector<int> ring, ringA, ringB;
+    for (int v = 0; v < n; ++v) {
+        neighbors(v, ring);
+        for (int u : ring) {
+            if (v < u) push(v, u);
+        }
+    }
+
+    int remaining = n;
+    for (int v = 0; v < n; ++v) {
+        if (incident[v].empty()) --remaining;
+    }
+
+    while (remaining > targetVertices && !heap.empty()) {
+        const Collapse c = heap.top();
+        heap.pop();
+
+        const int a = c.to, b = c.from;
+        if (!alive[a] || !alive[b] || stamp[a] != c.toStamp || stamp[b] != c.fromStamp) continue;
+
+        // Link condition: the edge's endpoints may only share the vertices opposite it,
+        // otherwise the collapse pinches the surface into a non-manifold one
+        neighbors(a, ringA);
+        neighbors(b, ringB);
+        int sharedFaces = 0;
+        for (int f : incident[a]) {
+            const Vector3i &face = faces[f];
+            if (face[0] == b || face[1] == b || face[2] == b) ++sharedFaces;
+        }
+        vector<int> common;
+        set_intersection(ringA.begin(), ringA.end(), ringB.begin(), ringB.end(), back_inserter(common));
+        if ((int) common.size() != sharedFaces) continue;
+
+        // No remaining face may flip or degenerate
+        bool flips = false;
+        for (int endpoint : { a, b }) {
+            for (int f : incident[endpoint]) {
+                const Vector3i &face = faces[f];
+                if ((face[0] == a || face[1] == a || face[2] == a) && (face[0] == b || face[1] == b || face[2] == b)) continue;
+
+                const Vector3d before = faceNormal(face, -1, Vector3d::Zero());
+                const Vector3d after  = faceNormal(face, endpoint, c.position);
+                if (after.norm() <= 1e-12 * before.norm() || before.normalized().dot(after.normalized()) < MIN_NORMAL_COSINE) {
+                    flips = true;
+                    break;
+                }
+            }
+            if (flips) break;
+        }
+        if (flips) continue;
+
+        // Collapse b into a
+        for (int f : incident[b]) {
+            Vector3i &face = faces[f];
+            if (face[0] == a || face[1] == a || face[2] == a) {
+                faceAlive[f] = 0;
+                for (int k = 0; k < 3; ++k) {
+                    const int v = face[k];
+                    if (v == b) continue;
+                    incident[v].erase(remove(incident[v].begin(), incident[v].end(), (int) f), incident[v].end());
+                }
+            } else {
+                for (int k = 0; k < 3; ++k) {
+                    if (face[k] == b) face[k] = a;
+                }
+                incident[a].push_back(f);
+            }
+        }
+        incident[b].clear();
+
+        position[a]  = c.position;
+        quadric[a]  += quadric[b];
+        parent[b]    = a;
+        alive[b]     = 0;
+        ++stamp[a];
+        --remaining;
+
+        neighbors(a, ring);
+        for (int u : ring) push(a, u);
+    }
+
+    // Compact the surviving vertices and faces into the proxy
+    vector<int> coarseIndex(n, -1);
+    m_coarseVertices.clear();
+    for (int v = 0; v < n; ++v) {
+        if (alive[v]) {
+            coarseIndex[v] = m_coarseVertices.size();
+            m_coarseVertices.push_back(position[v].cast<float>());
+        }
+    }
+
+    m_coarseTriangles.clear();
+    for (unsigned long f = 0; f < faces.size(); ++f) {
+        if (faceAlive[f]) m_coarseTriangles.emplace_back(coarseIndex[faces[f][0]], coarseIndex[faces[f][1]], coarseIndex[faces[f][2]]);
+    }
+
+    m_representative.resize(n);
+    for (int v = 0; v < n; ++v) {
+        int root = v;
+        while (parent[root] != root) root = parent[root];
+        m_representative[v] = coarseIndex[root];
+    }
+
+    m_fineRest.resize(n, 3);
+    for (int v = 0; v < n; ++v) m_fineRest.row(v) = vertices[v].cast<double>().transpose();
+    m_coarseRest.resize(m_coarseVertices.size(), 3);
+    for (unsigned long v = 0; v < m_coarseVertices.size(); ++v) m_coarseRest.row(v) = m_coarseVertices[v].cast<double>().transpose();
+
+    computeWeights(pool);
+}
+
+// Barycentric weights on the nearest proxy triangle among those around the representative
+// and its neighbours; a vertex of an isolated proxy vertex follows it alone
+void ProgressiveMesh::computeWeights(ThreadPool &pool)
+{
+    const int n = m_fineRest.rows();
+    const int m = m_coarseRest.rows();
+
+    vector<vector<int>> incident(m);
+    for (unsigned long f = 0; f < m_coarseTriangles.size(); ++f) {
+        for (int k = 0; k < 3; ++k) incident[m_coarseTriangles[f][k]].push_back(f);
+    }
+
+    m_weightIndices.assign(3 * n, 0);
+    m_weights.assign(3 * n, 0.0);
+
+    pool.parallelFor(0, n, [&](int begin, int end) {
+        vector<int> candidates;
+        for (int i = begin; i < end; ++i) {
+            const int r = m_representative[i];
+            const Vector3d p = m_fineRest.row(i).transpose();
+
+            candidates.clear();
+            for (int f : incident[r]) {
+                for (int k = 0; k < 3; ++k) candidates.insert(candidates.end(), incident[m_coarseTriangles[f][k]].begin(), incident[m_coarseTriangles[f][k]].end());
+            }
+            sort(candidates.begin(), candidates.end());
+            candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+            m_weightIndices[3 * i] = m_weightIndices[3 * i + 1] = m_weightIndices[3 * i + 2] = r;
+            m_weights[3 * i] = 1.0;
+
+            double best = numeric_limits<double>::infinity();
+            for (int f : candidates) {
+                const Vector3i &t = m_coarseTriangles[f];
+                const Vector3d a = m_coarseRest.row(t[0]).transpose();
+                const Vector3d b = m_coarseRest.row(t[1]).transpose();
+                const Vector3d c = m_coarseRest.row(t[2]).transpose();
+                const Vector3d w = closestBarycentric(p, a, b, c);
+                const double distance = (w[0] * a + w[1] * b + w[2] * c - p).squaredNorm();
+                if (distance < best) {
+                    best = distance;
+                    for (int k = 0; k < 3; ++k) {
+                        m_weightIndices[3 * i + k] = t[k];
+                        m_weights[3 * i + k]       = w[k];
+                    }
+                }
+            }
+        }
+    });
+}
+
+void ProgressiveMesh::prolong(const MatrixX3dRow &coarseDeformed, const vector<Matrix3d> &rotations,
+                              vector<Vector3f> &vertices, ThreadPool &pool) const
+{
+    const int n = m_fineRest.rows();
+    vertices.resize(n);
+
+    pool.parallelFor(0, n, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const Vector3d p = m_fineRest.row(i).transpose();
+            Vector3d result = Vector3d::Zero();
+            for (int k = 0; k < 3; ++k) {
+                const double w = m_weights[3 * i + k];
+                if (w == 0) continue;
+                const int c = m_weightIndices[3 * i + k];
+                result += w * (rotations[c] * (p - m_coarseRest.row(c).transpose()) + coarseDeformed.row(c).transpose());
+            }
+            vertices[i] = result.cast<float>();
+        }
+    });
+}
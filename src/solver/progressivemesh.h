@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+
+#define EIGEN_DONT_VECTORIZE
+#define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
+#include "Eigen/Dense"
+
+#include "solver/laplacian.h"
+
+class ThreadPool;
+
+// A coarse proxy of a mesh for solving ARAP at a fraction of the resolution, and the map
+// that carries a deformation of the proxy back to every vertex of the full mesh.
+//
+// The proxy comes from quadric error metric edge collapses (Garland & Heckbert 1997),
+// with collapses that would pinch the surface or flip a face skipped, and boundary edges
+// held in place by perpendicular planes. Each full-resolution vertex remembers which
+// proxy vertex it was collapsed into, and gets barycentric weights on the nearest proxy
+// triangle around that vertex. A deformed proxy, with a rotation R_k per proxy vertex,
+// is then prolonged as an affine blend:
+//
+//   p'_i = sum_k w_ik (R_k (p_i - c_k) + c'_k)
+//
+// which keeps the detail the proxy lost, since each offset from the proxy is rotated
+// along with it rather than flattened onto it.
+class ProgressiveMesh
+{
+public:
+    ProgressiveMesh();
+
+    // Simplifies the mesh down to about targetVertices vertices and computes the weights
+    void build(const std::vector<Eigen::Vector3f> &vertices, const std::vector<Eigen::Vector3i> &triangles,
+               int targetVertices, ThreadPool &pool);
+
+    bool isBuilt()           const { return !m_coarseVertices.empty(); }
+    int  getTargetVertices() const { return m_targetVertices; }
+
+    const std::vector<Eigen::Vector3f> &getCoarseVertices()  const { return m_coarseVertices;  }
+    const std::vector<Eigen::Vector3i> &getCoarseTriangles() const { return m_coarseTriangles; }
+
+    // The proxy vertex a full-resolution vertex was collapsed into
+    int getCoarseVertex(int vertex) const { return m_representative[vertex]; }
+
+    // Writes the full-resolution positions for a deformed proxy and its per-vertex rotations
+    void prolong(const MatrixX3dRow &coarseDeformed, const std::vector<Eigen::Matrix3d> &rotations,
+                 std::vector<Eigen::Vector3f> &vertices, ThreadPool &pool) const;
+
+private:
+    // Weight of the boundary-preserving planes relative to the face planes
+    static constexpr double BOUNDARY_WEIGHT = 100.0;
+    // Smallest cosine allowed between a face's normal before and after a collapse
+    static constexpr double MIN_NORMAL_COSINE = 0.2;
+
+    int m_targetVertices;
+
+    std::vector<Eigen::Vector3f> m_coarseVertices;
+    std::vector<Eigen::Vector3i> m_coarseTriangles;
+
+    // Rest positions, and three proxy vertices with barycentric weights per full vertex
+    MatrixX3dRow        m_fineRest;
+    MatrixX3dRow        m_coarseRest;
+    std::vector<int>    m_representative;
+    std::vector<int>    m_weightIndices;
+    std::vector<double> m_weights;
+
+    void computeWeights(ThreadPool &pool);
+};
@@ -0,0 +1,140 @@
+#include "regionofinterest.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+using namespace std;
+using namespace Eigen;
+
+RegionOfInterest::RegionOfInterest() :
+    m_factor(nullptr),
+    m_hits(0),
+    m_misses(0)
+{}
+
+void RegionOfInterest::reset(int vertices)
+{
+    m_regions.clear();
+    m_local.assign(vertices, -1);
+    m_factor = nullptr;
+    m_hits   = 0;
+    m_misses = 0;
+}
+
+bool RegionOfInterest::select(const SparseMatrix<double> &L, const MatrixX3dRow &rest, int handle,
+                              const vector<int> &anchors, int rings, double radius)
+{
+    auto cached = find_if(m_regions.begin(), m_regions.end(), [&](const Region &region) {
+        return region.handle == handle && region.rings == rings && (rings > 0 || region.radius == radius) && region.anchors == anchors;
+    });
+
+    // Clear the local numbering of the region that was current
+    if (!m_regions.empty()) {
+        for (int v : m_regions.front().vertices) m_local[v] = -1;
+    }
+
+    const bool found = cached != m_regions.end();
+    if (found) {
+        m_regions.splice(m_regions.begin(), m_regions, cached);
+        ++m_hits;
+    } else {
+        if ((int) m_regions.size() >= CACHED_REGIONS) m_regions.pop_back();
+        m_regions.emplace_front();
+        Region &region = m_regions.front();
+        region.handle  = handle;
+        region.anchors = anchors;
+        region.rings   = rings;
+        region.radius  = radius;
+        build(region, L, rest);
+        ++m_misses;
+    }
+
+    activate();
+    return !found;
+}
+
+void RegionOfInterest::build(Region &region, const SparseMatrix<double> &L, const MatrixX3dRow &rest)
+{
+    const int n = L.cols();
+
+    // Distance from the handle in rings or along edges, up to the region's extent
+    vector<double> distance(n, numeric_limits<double>::infinity());
+    vector<int> inside;
+    typedef pair<double, int> Entry;
+    priority_queue<Entry, vector<Entry>, greater<Entry>> queue;
+    const double extent = region.rings > 0 ? region.rings : region.radius;
+
+    distance[region.handle] = 0;
+    queue.emplace(0.0, region.handle);
+    while (!queue.empty()) {
+        const auto [d, i] = queue.top();
+        queue.pop();
+        if (d > distance[i]) continue;
+        inside.push_back(i);
+
+        for (SparseMatrix<double>::InnerIterator it(L, i); it; ++it) {
+            const int j = it.index();
+            if (j == i) continue;
+            const double through = d + (region.rings > 0 ? 1.0 : (rest.row(i) - rest.row(j)).norm());
+            if (through <= extent && through < distance[j]) {
+                distance[j] = through;
+                queue.emplace(through, j);
+            }
+        }
+    }
+
+    // Anchors inside are held, and so is the ring just outside
+    vector<char> isAnchor(n, 0);
+    for (int a : region.anchors) isAnchor[a] = 1;
+
+    vector<int> held;
+    region.vertices.clear();
+    for (int i : inside) {
+        if (isAnchor[i]) {
+            held.push_back(i);
+        } else {
+            region.vertices.push_back(i);
+        }
+    }
+    region.freeCount = region.vertices.size();
+
+    vector<char> seen(n, 0);
+    for (int i : inside) seen[i] = 1;
+    for (int i : inside) {
+        for (SparseMatrix<double>::InnerIterator it(L, i); it; ++it) {
+            if (seen[it.index()]) continue;
+            seen[it.index()] = 1;
+            held.push_back(it.index());
+        }
+    }
+    region.vertices.insert(region.vertices.end(), held.begin(), held.end());
+
+    // Principal submatrix of L on the region; the rows of free vertices are complete,
+    // since all their neighbours are in the region or its held ring
+    const int size = region.vertices.size();
+    vector<int> local(n, -1);
+    for (int a = 0; a < size; ++a) local[region.vertices[a]] = a;
+
+    vector<Triplet<double>> entries;
+    for (int a = 0; a < size; ++a) {
+        for (SparseMatrix<double>::InnerIterator it(L, region.vertices[a]); it; ++it) {
+            if (local[it.index()] >= 0) entries.emplace_back(local[it.index()], a, it.value());
+        }
+    }
+    region.L.resize(size, size);
+    region.L.setFromTriplets(entries.begin(), entries.end());
+
+    region.factors.reset(region.L);
+}
+
+void RegionOfInterest::activate()
+{
+    Region &region = m_regions.front();
+    for (unsigned long a = 0; a < region.vertices.size(); ++a) m_local[region.vertices[a]] = a;
+
+    vector<int> held(region.vertices.size() - region.freeCount);
+    for (unsigned long c = 0; c < held.size(); ++c) held[c] = region.freeCount + c;
+    m_factor = &region.factors.get(held);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <list>
+#include <vector>
+
+#include "solver/factorcache.h"
+#include "solver/laplacian.h"
+
+// The patch of a mesh around a dragged handle, to be solved on its own while everything
+// outside it stays put. The patch is the k-ring of the handle, or every vertex within a
+// geodesic radius of it (shortest paths along edges); the ring of vertices just outside
+// is held at its current positions, as are anchors inside, so the patch Laplacian with
+// those rows fixed is the whole global step. Its cost then scales with the patch rather
+// than with the mesh.
+//
+// Vertices are numbered locally with the free ones first and the held ones after them.
+// The patch, its Laplacian and its factor are cached for the last few handle sets (the
+// handle, the anchors and the patch size), so going back to a handle dragged recently
+// reuses them.
+class RegionOfInterest
+{
+public:
+    RegionOfInterest();
+
+    // Drops every cached region, e.g. for a new mesh with the given vertex count
+    void reset(int vertices);
+
+    // Makes the region around handle current, with rings > 0 giving a k-ring and rings = 0
+    // a geodesic radius. Returns whether it had to be built rather than found in the cache.
+    bool select(const Eigen::SparseMatrix<double> &L, const MatrixX3dRow &rest, int handle,
+                const std::vector<int> &anchors, int rings, double radius);
+
+    // Global ids of the region's vertices in local order: free vertices, then held ones
+    const std::vector<int> &getVertices() const { return m_regions.front().vertices;  }
+    int                     getFreeCount() const { return m_regions.front().freeCount; }
+
+    // Local index of a vertex of the current region and its held ring, -1 for any other
+    int toLocal(int vertex) const { return m_local[vertex]; }
+
+    // The region's Laplacian factored with its held rows fixed, and L_fc for them
+    const SparseLDLT                  &getFactor()   const { return *m_factor; }
+    const Eigen::SparseMatrix<double> &getCoupling() const { return m_regions.front().factors.getCoupling(); }
+
+    const Eigen::SparseMatrix<double> &getLaplacian() const { return m_regions.front().L; }
+
+    int getHits()   const { return m_hits;   }
+    int getMisses() const { return m_misses; }
+
+private:
+    static const int CACHED_REGIONS = 4;
+
+    struct Region
+    {
+        int              handle;
+        std::vector<int> anchors;
+        int              rings;
+        double           radius;
+
+        std::vector<int>            vertices;
+        int                         freeCount;
+        Eigen::SparseMatrix<double> L;
+        FactorCache                 factors;
+    };
+
+    // Most recently used first
+    std::list<Region> m_regions;
+    std::vector<int>  m_local;
+    const SparseLDLT *m_factor;
+    int               m_hits;
+    int               m_misses;
+
+    void build(Region &region, const Eigen::SparseMatrix<double> &L, const MatrixX3dRow &rest);
+    void activate();
+};
@@ -0,0 +1,81 @@
+#include "rotationfit.h"
+#include "solver/svdkernel.h"
+
+using namespace std;
+using namespace Eigen;
+
+#ifdef ARAP_X86_SIMD
+// Defined in rotationfit_avx2.cpp and rotationfit_avx512.cpp, built with those ISAs enabled.
+// They take raw arrays so that no Eigen code is ever compiled for those ISAs.
+int fitRotationsAvx2  (const double *covariances, double *rotations, int count);
+int fitRotationsAvx512(const double *covariances, double *rotations, int count);
+#endif
+
+// The kernels read and write arrays of Matrix3d as packed column-major doubles
+static_assert(sizeof(Matrix3d) == 9 * sizeof(double), "Matrix3d must be 9 packed doubles");
+
+RotationFit::RotationFit() {}
+
+int RotationFit::batchWidth()
+{
+#ifdef ARAP_X86_SIMD
+    static const int width = __builtin_cpu_supports("avx512f") ? 8 : __builtin_cpu_supports("avx2") ? 4 : 2;
+    return width;
+#elif defined(__GNUC__)
+    return 2;
+#else
+    return 1;
+#endif
+}
+
+void RotationFit::fit(const Matrix3d *covariances, Matrix3d *rotations, int count)
+{
+    if (count <= 0) return;
+
+    const double *in  = covariances->data();
+    double       *out = rotations->data();
+    int done = 0;
+
+#ifdef ARAP_X86_SIMD
+    if (batchWidth() == 8) done = fitRotationsAvx512(in, out, count);
+    else if (batchWidth() == 4) done = fitRotationsAvx2(in, out, count);
+#endif
+
+#ifdef __GNUC__
+    typedef double Lane2 __attribute__((vector_size(16)));
+    done += svdkernel::fitRotationBlocks<Lane2>(in + 9 * done, out + 9 * done, count - done);
+#endif
+
+    svdkernel::fitRotationBlocks<double>(in + 9 * done, out + 9 * done, count - done);
+}
+
+void RotationFit::fitScalar(const Matrix3d *covariances, Matrix3d *rotations, int count)
+{
+    if (count <= 0) return;
+    svdkernel::fitRotationBlocks<double>(covariances->data(), rotations->data(), count);
+}
+
+void RotationFit::fitWarmStarted(const Matrix3d *covariances, Quaterniond *quaternions,
+                                 Matrix3d *rotations, int count, int iterations)
+{
+    for (int i = 0; i < count; ++i) {
+        // R maximizes tr(R S) = sum_k r_k . a_k over the columns of A = S^T
+        const Matrix3d a = covariances[i].transpose();
+        Quaterniond q = quaternions[i];
+
+        for (int iteration = 0; iteration < iterations; ++iteration) {
+            const Matrix3d r = q.toRotationMatrix();
+            const Vector3d torque = r.col(0).cross(a.col(0)) + r.col(1).cross(a.col(1)) + r.col(2).cross(a.col(2));
+            const double   align  = r.col(0).dot(a.col(0))   + r.col(1).dot(a.col(1))   + r.col(2).dot(a.col(2));
+
+            const Vector3d omega = torque / (abs(align) + 1e-9);
+            const double   angle = omega.norm();
+            if (angle < 1e-9) break;
+
+            q = (Quaterniond(AngleAxisd(angle, omega / angle)) * q).normalized();
+        }
+
+        quaternions[i] = q;
+        rotations[i]   = q.toRotationMatrix();
+    }
+}
@@ -0,0 +1,8 @@
+#include "solver/svdkernel.h"
+
+// Compiled with -mavx2, so each 4-double lane vector is a single ymm register
+int fitRotationsAvx2(const double *covariances, double *rotations, int count)
+{
+    typedef double Lane4 __attribute__((vector_size(32)));
+    return svdkernel::fitRotationBlocks<Lane4>(covariances, rotations, count);
+}
@@ -0,0 +1,8 @@
+#include "solver/svdkernel.h"
+
+// Compiled with -mavx512f, so each 8-double lane vector is a single zmm register
+int fitRotationsAvx512(const double *covariances, double *rotations, int count)
+{
+    typedef double Lane8 __attribute__((vector_size(64)));
+    return svdkernel::fitRotationBlocks<Lane8>(covariances, rotations, count);
+}
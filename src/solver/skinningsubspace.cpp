@@ -0,0 +1,223 @@
+#include "skinningsubspace.h"
+#include "clustering.h"
+#include "rotationfit.h"
+#include "sparseldlt.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace Eigen;
+
+SkinningSubspace::SkinningSubspace() :
+    m_handleCount(DEFAULT_HANDLES),
+    m_clusterCount(DEFAULT_CLUSTERS),
+    m_valid(false),
+    m_clusters(0)
+{}
+
+void SkinningSubspace::reset()
+{
+    m_valid = false;
+    m_anchors.clear();
+}
+
+bool SkinningSubspace::setAnchors(const vector<int> &anchors, const MatrixX3dRow &rest, const vector<Vector3i> &triangles,
+                                  const SparseMatrix<double> &L, const MatrixX3dRow &current, ThreadPool &pool)
+{
+    if (m_valid && anchors == m_anchors) return false;
+
+    m_anchors = anchors;
+    const int n = rest.rows();
+
+    // Handles: the anchors first, then free handles spread over the rest shape
+    MatrixXd restPoints = rest;
+    m_handles.clear();
+    if ((int) anchors.size() <= MAX_ANCHOR_HANDLES) {
+        m_handles = anchors;
+    } else {
+        MatrixXd anchorPoints(anchors.size(), 3);
+        for (unsigned long a = 0; a < anchors.size(); ++a) anchorPoints.row(a) = rest.row(anchors[a]);
+        vector<int> picked;
+        Clustering::farthestPoints(anchorPoints, MAX_ANCHOR_HANDLES, picked);
+        for (int a : picked) m_handles.push_back(anchors[a]);
+    }
+    Clustering::farthestPoints(restPoints, max(m_handleCount, (int) m_handles.size()), m_handles);
+    const int m = m_handles.size();
+
+    MatrixXd weights;
+    computeWeights(rest, triangles, L, weights);
+
+    // M(i, 4j + c) = w_ij [p_i; 1]_c
+    m_basis.resize(n, 4 * m);
+    pool.parallelFor(0, n, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const Vector4d p(rest(i, 0), rest(i, 1), rest(i, 2), 1.0);
+            for (int j = 0; j < m; ++j) m_basis.row(i).segment<4>(4 * j) = weights(i, j) * p.transpose();
+        }
+    });
+
+    // Vertices with similar weights move alike, so they share a rotation
+    m_clusters = Clustering::kMeans(weights, max(m_clusterCount, 1), m_labels, pool);
+    const int k = m_clusters;
+
+    // F_c  = sum over i in c, j ~ i of w_ij e_ij (M_i - M_j)
+    // H_c  = sum over i, j ~ i of w_ij / 2 M_i^T e_ij^T ([c(i) = c] + [c(j) = c]),
+    // so that the covariance of cluster c is F_c X and M^T b = sum_c H_c R_c^T
+    m_F = MatrixXd::Zero(3 * k, 4 * m);
+    MatrixXd H = MatrixXd::Zero(4 * m, 3 * k);
+    //
+    // The M_i terms only need the weighted edges summed over the one-ring; every update is
+    // an outer product written straight into F or H, with no temporaries
+    for (int i = 0; i < n; ++i) {
+        const int ci = m_labels[i];
+        Vector3d edgeSum = Vector3d::Zero();
+        for (SparseMatrix<double>::InnerIterator it(L, i); it; ++it) {
+            const int j = it.row();
+            if (j == i) continue;
+
+            const Vector3d edge = -it.value() * (rest.row(i) - rest.row(j)).transpose();
+            edgeSum += edge;
+            m_F.middleRows<3>(3 * ci).noalias()         -= edge * m_basis.row(j);
+            H.middleCols<3>(3 * m_labels[j]).noalias() += m_basis.row(i).transpose() * (0.5 * edge).transpose();
+        }
+        m_F.middleRows<3>(3 * ci).noalias() += edgeSum * m_basis.row(i);
+        H.middleCols<3>(3 * ci).noalias()   += m_basis.row(i).transpose() * (0.5 * edgeSum).transpose();
+    }
+
+    // Global step: minimize tr(X^T A X) - 2 tr(X^T M^T b) subject to M_a X = targets.
+    // Translations of all handles at once lie in the null space of A, and the anchors
+    // only pin them down through the constraints, so the KKT matrix can still be
+    // singular for degenerate handle layouts; the orthogonal decomposition copes.
+    const int a = anchors.size();
+    const MatrixXd LM = L * m_basis;
+    MatrixXd kkt = MatrixXd::Zero(4 * m + a, 4 * m + a);
+    kkt.topLeftCorner(4 * m, 4 * m) = m_basis.transpose() * LM;
+    for (int c = 0; c < a; ++c) {
+        kkt.block(4 * m + c, 0, 1, 4 * m) = m_basis.row(anchors[c]);
+        kkt.block(0, 4 * m + c, 4 * m, 1) = m_basis.row(anchors[c]).transpose();
+    }
+    const MatrixXd inverse = kkt.completeOrthogonalDecomposition().pseudoInverse();
+    m_G         = inverse.topLeftCorner(4 * m, 4 * m) * H;
+    m_targetMap = inverse.topRightCorner(4 * m, a);
+
+    // Start from the transforms that best reproduce the current positions
+    MatrixXd normal = m_basis.transpose() * m_basis;
+    normal.diagonal().array() += 1e-9 * normal.trace() / normal.rows();
+    m_X = normal.ldlt().solve(m_basis.transpose() * current);
+
+    m_covarianceStack.resize(3 * k, 3);
+    m_rotationStack.resize(3 * k, 3);
+    m_covariances.resize(k);
+    m_rotations.resize(k);
+
+    m_valid = true;
+    return true;
+}
+
+// Biharmonic weights: each column minimizes the Laplacian energy w^T L M^-1 L w with the
+// lumped mass M, subject to w = 1 at its handle and 0 at the others. The bounds of true
+// bounded biharmonic weights would need a QP per handle; clamping to [0, 1] and
+// renormalizing afterwards keeps them a partition of unity at the cost of smoothness
+// where they would overshoot.
+void SkinningSubspace::computeWeights(const MatrixX3dRow &rest, const vector<Vector3i> &triangles,
+                                      const SparseMatrix<double> &L, MatrixXd &weights) const
+{
+    const int n = rest.rows();
+    const int m = m_handles.size();
+
+    VectorXd mass = VectorXd::Zero(n);
+    for (const Vector3i &t : triangles) {
+        const Vector3d a = rest.row(t[0]), b = rest.row(t[1]), c = rest.row(t[2]);
+        const double area = 0.5 * (b - a).cross(c - a).norm() / 3.0;
+        for (int k = 0; k < 3; ++k) mass[t[k]] += area;
+    }
+    const double minMass = 1e-8 * max(mass.mean(), 1e-300);
+    const VectorXd inverseMass = mass.cwiseMax(minMass).cwiseInverse();
+
+    const SparseMatrix<double> Q = L * inverseMass.asDiagonal() * L;
+
+    // Handle rows and columns become identity rows; their coupling moves to the right-hand side
+    vector<char> isHandle(n, 0);
+    for (int h : m_handles) isHandle[h] = 1;
+
+    SparseMatrix<double> constrained = Q;
+    for (int col = 0; col < n; ++col) {
+        for (SparseMatrix<double>::InnerIterator it(constrained, col); it; ++it) {
+            if (isHandle[it.row()] || isHandle[col]) it.valueRef() = it.row() == col ? 1.0 : 0.0;
+        }
+    }
+
+    SparseLDLT factor;
+    factor.analyzePattern(constrained);
+    factor.factorize(constrained);
+
+    weights.resize(n, m);
+    VectorXd column(n);
+    for (int j = 0; j < m; ++j) {
+        column.setZero();
+        for (SparseMatrix<double>::InnerIterator it(Q, m_handles[j]); it; ++it) {
+            if (!isHandle[it.row()]) column[it.row()] = -it.value();
+        }
+        column[m_handles[j]] = 1.0;
+        factor.solveInPlace(column);
+        weights.col(j) = column;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        weights.row(i) = weights.row(i).cwiseMax(0.0).cwiseMin(1.0);
+        const double sum = weights.row(i).sum();
+        if (sum > 0) {
+            weights.row(i) /= sum;
+        } else {
+            // Nothing reached this vertex, e.g. a component without handles
+            int    nearest  = 0;
+            double distance = INFINITY;
+            for (int j = 0; j < m; ++j) {
+                const double d = (rest.row(m_handles[j]) - rest.row(i)).squaredNorm();
+                if (d < distance) {
+                    distance = d;
+                    nearest  = j;
+                }
+            }
+            weights(i, nearest) = 1.0;
+        }
+    }
+}
+
+int SkinningSubspace::solve(const MatrixX3dRow &anchorTargets, int maxIterations, double tolerance)
+{
+    if (!m_valid) return 0;
+
+    const int k = m_clusters;
+    m_targetShare.noalias() = m_targetMap * anchorTargets;
+
+    int iteration = 0;
+    while (iteration < maxIterations) {
+        ++iteration;
+
+        // Local step: one rotation per cluster from its covariance F_c X
+        m_covarianceStack.noalias() = m_F.lazyProduct(m_X);
+        for (int c = 0; c < k; ++c) m_covariances[c] = m_covarianceStack.middleRows<3>(3 * c);
+        RotationFit::fit(m_covariances.data(), m_rotations.data(), k);
+
+        // Global step, with the KKT solve folded into G
+        for (int c = 0; c < k; ++c) m_rotationStack.middleRows<3>(3 * c) = m_rotations[c].transpose();
+        m_next = m_targetShare;
+        m_next.noalias() += m_G.lazyProduct(m_rotationStack);
+
+        const double change = (m_next - m_X).norm();
+        m_X.swap(m_next);
+        if (change <= tolerance * m_X.norm()) return iteration;
+    }
+    return iteration;
+}
+
+void SkinningSubspace::skin(MatrixX3dRow &positions, ThreadPool &pool) const
+{
+    positions.resize(m_basis.rows(), 3);
+    pool.parallelFor(0, m_basis.rows(), [&](int begin, int end) {
+        positions.middleRows(begin, end - begin).noalias() = m_basis.middleRows(begin, end - begin) * m_X;
+    });
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vector>
+
+#define EIGEN_DONT_VECTORIZE
+#define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
+#include "Eigen/Dense"
+#include "Eigen/Sparse"
+
+#include "solver/laplacian.h"
+
+class ThreadPool;
+
+// ARAP restricted to a linear blend skinning subspace (Jacobson et al. 2012, "Fast
+// automatic skinning transformations"). Every vertex is a blend of m handle transforms,
+//
+//   p'_i = sum_j w_ij T_j [p_i; 1]   i.e.   P' = M X
+//
+// with M the n x 4m matrix of weighted homogeneous rest positions and X the stacked 4 x 3
+// transposes of the affine T_j. Handles are the anchors plus extra free handles spread
+// by farthest-point sampling; the weights are biharmonic (L M^-1 L w = 0 with w fixed to
+// one at its own handle and zero at the others), clamped to [0, 1] and renormalized.
+// Vertices are grouped into clusters by k-means in weight space, and each cluster shares
+// one rotation.
+//
+// Everything that touches all vertices is precomputed once per anchor set: the covariance
+// of cluster c is F_c X, the right-hand side is sum_c H_c R_c^T, and the global step is a
+// dense KKT system in A = M^T L M with the anchors as equality constraints. An iteration
+// then costs a few hundred small dense products, independent of the mesh size, and the
+// vertices are only touched by the final skinning pass.
+class SkinningSubspace
+{
+public:
+    SkinningSubspace();
+
+    // Drops the precomputation, e.g. for a new mesh
+    void reset();
+
+    // Precomputes weights, clusters and reduced matrices for the (sorted) anchors, unless
+    // they are the cached ones. The transforms start as the best fit to current. Returns
+    // whether anything was recomputed.
+    bool setAnchors(const std::vector<int> &anchors, const MatrixX3dRow &rest, const std::vector<Eigen::Vector3i> &triangles,
+                    const Eigen::SparseMatrix<double> &L, const MatrixX3dRow &current, ThreadPool &pool);
+
+    // Local/global iterations on the handle transforms with the anchors at their targets
+    // (one row per anchor), until the transforms change by less than tolerance relative
+    // to their size; returns the iterations taken, which is maxIterations if it did not
+    // converge. Each iteration costs O(k m), whatever the size of the mesh.
+    int solve(const MatrixX3dRow &anchorTargets, int maxIterations, double tolerance);
+
+    // P' = M X, in parallel over vertices
+    void skin(MatrixX3dRow &positions, ThreadPool &pool) const;
+
+    // Total handles (anchors beyond this count all become handles) and rotation clusters;
+    // both take effect at the next precomputation
+    void setHandleCount(int handles) { m_handleCount = handles; reset(); }
+    void setClusterCount(int clusters) { m_clusterCount = clusters; reset(); }
+    int  getHandleCount()  const { return m_handleCount;  }
+    int  getClusterCount() const { return m_clusterCount; }
+
+private:
+    static const int DEFAULT_HANDLES  = 10;
+    static const int DEFAULT_CLUSTERS = 100;
+
+    // Past this many anchors, only a farthest-point subset of them gets its own handle and
+    // the rest are constrained through the weights of their neighbours
+    static const int MAX_ANCHOR_HANDLES = 32;
+
+    int m_handleCount;
+    int m_clusterCount;
+
+    bool             m_valid;
+    std::vector<int> m_anchors;
+    std::vector<int> m_handles;
+    std::vector<int> m_labels;
+    int              m_clusters;
+
+    // M and the cluster covariance maps F (3k x 4m, one 3 x 4m block per cluster). With
+    // K the pseudo-inverse of the KKT matrix [A C^T; C 0] of the global step, G = K_11 H
+    // maps the stacked R_c^T straight to X, and K_12 maps the anchor targets to their
+    // (constant) share of it.
+    Eigen::MatrixXd m_basis;
+    Eigen::MatrixXd m_F;
+    Eigen::MatrixXd m_G;
+    Eigen::MatrixXd m_targetMap;
+
+    Eigen::MatrixXd              m_X;
+    Eigen::MatrixXd              m_next;
+    Eigen::MatrixXd              m_covarianceStack;
+    Eigen::MatrixXd              m_rotationStack;
+    Eigen::MatrixXd              m_targetShare;
+    std::vector<Eigen::Matrix3d> m_covariances;
+    std::vector<Eigen::Matrix3d> m_rotations;
+
+    void computeWeights(const MatrixX3dRow &rest, const std::vector<Eigen::Vector3i> &triangles,
+                        const Eigen::SparseMatrix<double> &L, Eigen::MatrixXd &weights) const;
+};
@@ -0,0 +1,291 @@
+#include "sparseldlt.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace Eigen;
+
+// Pivots below this are treated as a breakdown of an update, which the caller then
+// recovers from with a full factorization
+static const double MIN_PIVOT = 1e-14;
+
+SparseLDLT::SparseLDLT() :
+    m_n(0),
+    m_flops(0),
+    m_stamp(0)
+{}
+
+// ================== Symbolic Analysis
+
+void SparseLDLT::analyzePattern(const SparseMatrix<double> &A, FillOrdering ordering)
+{
+    m_n = A.rows();
+    const int n = m_n;
+
+    FillReduction::order(A, ordering, m_perm);
+    m_invPerm.resize(n);
+    for (int k = 0; k < n; ++k) m_invPerm[m_perm[k]] = k;
+
+    // Upper triangle of P A P^T, remembering where each value lives in A
+    m_Cp.assign(n + 1, 0);
+    for (int j = 0; j < n; ++j) {
+        for (int p = A.outerIndexPtr()[j]; p < A.outerIndexPtr()[j + 1]; ++p) {
+            const int i = A.innerIndexPtr()[p];
+            if (m_invPerm[i] <= m_invPerm[j]) ++m_Cp[m_invPerm[j] + 1];
+        }
+    }
+    for (int j = 0; j < n; ++j) m_Cp[j + 1] += m_Cp[j];
+
+    m_Ci.resize(m_Cp[n]);
+    m_Cmap.resize(m_Cp[n]);
+    vector<int> cursor(m_Cp.begin(), m_Cp.end() - 1);
+    for (int j = 0; j < n; ++j) {
+        for (int p = A.outerIndexPtr()[j]; p < A.outerIndexPtr()[j + 1]; ++p) {
+            const int i = A.innerIndexPtr()[p];
+            if (m_invPerm[i] > m_invPerm[j]) continue;
+            const int q = cursor[m_invPerm[j]]++;
+            m_Ci[q]   = m_invPerm[i];
+            m_Cmap[q] = p;
+        }
+    }
+
+    // Elimination tree and column counts of L
+    m_parent.assign(n, -1);
+    m_mark.assign(n, -1);
+    vector<int> count(n, 0);
+    for (int k = 0; k < n; ++k) {
+        m_mark[k] = k;
+        for (int p = m_Cp[k]; p < m_Cp[k + 1]; ++p) {
+            for (int i = m_Ci[p]; m_mark[i] != k; i = m_parent[i]) {
+                if (m_parent[i] == -1) m_parent[i] = k;
+                ++count[i];
+                m_mark[i] = k;
+            }
+        }
+    }
+
+    m_Lp.assign(n + 1, 0);
+    m_flops = 0;
+    for (int k = 0; k < n; ++k) {
+        m_Lp[k + 1] = m_Lp[k] + count[k];
+        m_flops += double(count[k]) * (count[k] + 3);
+    }
+    m_Li.assign(m_Lp[n], 0);
+    m_Lx.assign(m_Lp[n], 0.0);
+    m_D.assign(n, 0.0);
+
+    m_work.assign(n, 0.0);
+    m_blockWork.resize(n, 3);
+    m_mark.assign(n, -1);
+    m_pattern.clear();
+    m_pattern.reserve(n);
+    m_stamp = 0;
+}
+
+// Row k of L (the columns j < k with L_kj structurally nonzero), in ascending order
+void SparseLDLT::rowPattern(int k)
+{
+    const int stamp = ++m_stamp;
+    m_pattern.clear();
+    m_mark[k] = stamp;
+    for (int p = m_Cp[k]; p < m_Cp[k + 1]; ++p) {
+        for (int i = m_Ci[p]; m_mark[i] != stamp; i = m_parent[i]) {
+            m_pattern.push_back(i);
+            m_mark[i] = stamp;
+        }
+    }
+    sort(m_pattern.begin(), m_pattern.end());
+}
+
+// Position of L(row, column) in the column storage; rows are sorted within a column
+int SparseLDLT::find(int column, int row) const
+{
+    return lower_bound(m_Li.begin() + m_Lp[column], m_Li.begin() + m_Lp[column + 1], row) - m_Li.begin();
+}
+
+// ================== Numeric Factorization
+
+bool SparseLDLT::factorize(const SparseMatrix<double> &A)
+{
+    const int n = m_n;
+    const double *values = A.valuePtr();
+    vector<int> filled(n, 0);
+
+    for (int k = 0; k < n; ++k) {
+        // Scatter column k of the upper triangle; its reach in the etree is row k of L
+        rowPattern(k);
+        for (int p = m_Cp[k]; p < m_Cp[k + 1]; ++p) m_work[m_Ci[p]] += values[m_Cmap[p]];
+
+        double d = m_work[k];
+        m_work[k] = 0;
+
+        for (int j : m_pattern) {
+            const double y = m_work[j];
+            m_work[j] = 0;
+
+            const int end = m_Lp[j] + filled[j];
+            for (int p = m_Lp[j]; p < end; ++p) m_work[m_Li[p]] -= m_Lx[p] * y;
+
+            const double l = y / m_D[j];
+            d -= l * y;
+            m_Li[end] = k;
+            m_Lx[end] = l;
+            ++filled[j];
+        }
+
+        if (abs(d) < MIN_PIVOT) return false;
+        m_D[k] = d;
+    }
+
+    return true;
+}
+
+// ================== Row Modifications
+
+// L D L^T + sigma w w^T, where w is held in m_work and its first nonzero is at `start`.
+// Every nonzero of w lies on the etree path from `start`, so that is all that is touched.
+bool SparseLDLT::rankOneUpdate(int start, double sigma)
+{
+    double alpha = sigma;
+    bool ok = true;
+
+    for (int j = start; j != -1; j = m_parent[j]) {
+        const double p = m_work[j];
+        m_work[j] = 0;
+        if (p == 0) continue;
+
+        const double d    = m_D[j];
+        const double dBar = d + alpha * p * p;
+        if (dBar < MIN_PIVOT) ok = false;
+
+        const double beta = p * alpha / dBar;
+        alpha *= d / dBar;
+        m_D[j] = dBar;
+
+        for (int q = m_Lp[j]; q < m_Lp[j + 1]; ++q) {
+            m_work[m_Li[q]] -= p * m_Lx[q];
+            m_Lx[q] += beta * m_work[m_Li[q]];
+        }
+    }
+
+    return ok;
+}
+
+bool SparseLDLT::deleteRow(int index)
+{
+    const int k = m_invPerm[index];
+
+    // Row k of L becomes zero
+    rowPattern(k);
+    for (int j : m_pattern) m_Lx[find(j, k)] = 0;
+
+    // Column k folds into the trailing block: L33 D33 L33^T += d_k l32 l32^T
+    const double d = m_D[k];
+    for (int q = m_Lp[k]; q < m_Lp[k + 1]; ++q) {
+        m_work[m_Li[q]] = m_Lx[q];
+        m_Lx[q] = 0;
+    }
+    m_D[k] = 1;
+
+    return m_Lp[k] == m_Lp[k + 1] || rankOneUpdate(m_parent[k], d);
+}
+
+bool SparseLDLT::addRow(int index, const SparseMatrix<double> &A)
+{
+    const int k = m_invPerm[index];
+
+    // Scatter row k of A, split around the diagonal: a12 and a32 both go to m_work
+    double d = 0;
+    for (int p = A.outerIndexPtr()[index]; p < A.outerIndexPtr()[index + 1]; ++p) {
+        const int i = m_invPerm[A.innerIndexPtr()[p]];
+        if (i == k) d = A.valuePtr()[p];
+        else        m_work[i] = A.valuePtr()[p];
+    }
+
+    // Solve L11 x = a12 in ascending column order, pushing L31 x into the rows below k.
+    // Then l12 = D11^-1 x, and m_work below k ends up as a32 - L31 D11 l12.
+    rowPattern(k);
+    for (int j : m_pattern) {
+        const double x = m_work[j];
+        m_work[j] = 0;
+
+        for (int q = m_Lp[j]; q < m_Lp[j + 1]; ++q) {
+            if (m_Li[q] != k) m_work[m_Li[q]] -= m_Lx[q] * x;
+        }
+
+        const double l = x / m_D[j];
+        m_Lx[find(j, k)] = l;
+        d -= l * x;
+    }
+
+    if (d < MIN_PIVOT) {
+        for (int q = m_Lp[k]; q < m_Lp[k + 1]; ++q) m_work[m_Li[q]] = 0;
+        return false;
+    }
+
+    // l32 = (a32 - L31 D11 l12) / d22, then L33 D33 L33^T -= d22 l32 l32^T
+    m_D[k] = d;
+    for (int q = m_Lp[k]; q < m_Lp[k + 1]; ++q) {
+        m_Lx[q] = m_work[m_Li[q]] / d;
+        m_work[m_Li[q]] = m_Lx[q];
+    }
+
+    return m_Lp[k] == m_Lp[k + 1] || rankOneUpdate(m_parent[k], -d);
+}
+
+// ================== Solving
+
+void SparseLDLT::solveInPlace(VectorXd &b) const
+{
+    const int n = m_n;
+    vector<double> &y = m_work;
+
+    for (int k = 0; k < n; ++k) y[k] = b[m_perm[k]];
+
+    for (int j = 0; j < n; ++j) {
+        for (int p = m_Lp[j]; p < m_Lp[j + 1]; ++p) y[m_Li[p]] -= m_Lx[p] * y[j];
+    }
+    for (int j = 0; j < n; ++j) y[j] /= m_D[j];
+    for (int j = n - 1; j >= 0; --j) {
+        for (int p = m_Lp[j]; p < m_Lp[j + 1]; ++p) y[j] -= m_Lx[p] * y[m_Li[p]];
+    }
+
+    for (int k = 0; k < n; ++k) {
+        b[m_perm[k]] = y[k];
+        y[k] = 0;
+    }
+}
+
+void SparseLDLT::solveInPlace(MatrixX3dRow &B) const
+{
+    const int n = m_n;
+    double *y = m_blockWork.data();
+
+    for (int k = 0; k < n; ++k) m_blockWork.row(k) = B.row(m_perm[k]);
+
+    for (int j = 0; j < n; ++j) {
+        const double y0 = y[3 * j], y1 = y[3 * j + 1], y2 = y[3 * j + 2];
+        for (int p = m_Lp[j]; p < m_Lp[j + 1]; ++p) {
+            double *row = y + 3 * m_Li[p];
+            const double l = m_Lx[p];
+            row[0] -= l * y0;
+            row[1] -= l * y1;
+            row[2] -= l * y2;
+        }
+    }
+    for (int j = 0; j < n; ++j) m_blockWork.row(j) /= m_D[j];
+    for (int j = n - 1; j >= 0; --j) {
+        double y0 = y[3 * j], y1 = y[3 * j + 1], y2 = y[3 * j + 2];
+        for (int p = m_Lp[j]; p < m_Lp[j + 1]; ++p) {
+            const double *row = y + 3 * m_Li[p];
+            const double l = m_Lx[p];
+            y0 -= l * row[0];
+            y1 -= l * row[1];
+            y2 -= l * row[2];
+        }
+        y[3 * j] = y0; y[3 * j + 1] = y1; y[3 * j + 2] = y2;
+    }
+
+    for (int k = 0; k < n; ++k) B.row(m_perm[k]) = m_blockWork.row(k);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+
+#define EIGEN_DONT_VECTORIZE
+#define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
+#include "Eigen/Dense"
+#include "Eigen/Sparse"
+
+#include "solver/fillordering.h"
+#include "solver/laplacian.h"
+
+// Up-looking sparse LDL^T factorization of a symmetric matrix, P A P^T = L D L^T.
+//
+// The symbolic analysis (fill-reducing ordering, elimination tree and the full pattern
+// of L) is computed once by analyzePattern(); factorize() then only fills in values for
+// matrices with that same pattern. Because the pattern of L is kept fixed, a single row
+// and column can also be swapped between its values in A and an identity row in place,
+// with the cost of a sparse triangular solve plus one rank-1 update or downdate along a
+// path of the elimination tree (Davis & Hager's row addition/deletion).
+class SparseLDLT
+{
+public:
+    SparseLDLT();
+
+    void analyzePattern(const Eigen::SparseMatrix<double> &A, FillOrdering ordering = FillOrdering::MinimumDegree);
+    bool factorize(const Eigen::SparseMatrix<double> &A);
+
+    // Replaces row and column `index` of the factored matrix by the identity row
+    bool deleteRow(int index);
+    // Restores row and column `index`, currently an identity row, to its entries in A.
+    // A must have the analyzed pattern and already hold the new values.
+    bool addRow(int index, const Eigen::SparseMatrix<double> &A);
+
+    // Solves A x = b, overwriting b with x
+    void solveInPlace(Eigen::VectorXd &b) const;
+    // Solves for all three coordinates in one pass, loading each factor entry once
+    void solveInPlace(MatrixX3dRow &B) const;
+
+    int    rows()      const { return m_n; }
+    long   nonZeros()  const { return m_Lp.empty() ? 0 : m_Lp.back(); }
+    double flops()     const { return m_flops; }
+
+private:
+    int m_n;
+
+    // Fill-reducing permutation: m_perm[new] = old, m_invPerm[old] = new
+    std::vector<int> m_perm;
+    std::vector<int> m_invPerm;
+
+    // Upper triangle of P A P^T by columns, with each entry's position in A's value array
+    std::vector<int> m_Cp;
+    std::vector<int> m_Ci;
+    std::vector<int> m_Cmap;
+
+    // Elimination tree and the strictly lower, unit-diagonal factor L by columns
+    std::vector<int>    m_parent;
+    std::vector<int>    m_Lp;
+    std::vector<int>    m_Li;
+    std::vector<double> m_Lx;
+    std::vector<double> m_D;
+    double              m_flops;
+
+    // Scratch space, kept between calls to avoid reallocation
+    mutable std::vector<double> m_work;
+    mutable MatrixX3dRow        m_blockWork;
+    std::vector<int> m_mark;
+    std::vector<int> m_pattern;
+    int              m_stamp;
+
+    void rowPattern(int k);
+    int  find(int column, int row) const;
+    bool rankOneUpdate(int start, double sigma);
+};
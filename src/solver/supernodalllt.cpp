@@ -0,0 +1,475 @@
+#include "supernodalllt.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <queue>
+
+using namespace std;
+using namespace Eigen;
+
+// Row of the calling thread's current supernode, by global row; only entries for the
+// rows of that supernode are meaningful
+static thread_local vector<int> t_local;
+
+SupernodalLLT::SupernodalLLT() :
+    m_n(0),
+    m_nonZeros(0),
+    m_flops(0)
+{}
+
+// ================== Symbolic Analysis
+
+void SupernodalLLT::analyzePattern(const SparseMatrix<double> &A, FillOrdering ordering)
+{
+    m_n = A.rows();
+    const int n = m_n;
+    const int *outer = A.outerIndexPtr();
+    const int *inner = A.innerIndexPtr();
+
+    vector<int> perm;
+    FillReduction::order(A, ordering, perm);
+    vector<int> invPerm(n);
+    for (int k = 0; k < n; ++k) invPerm[perm[k]] = k;
+
+    // Elimination tree and column counts of L, walking the row subtrees as SparseLDLT does
+    vector<int> parent(n, -1), count(n, 0), mark(n, -1);
+    for (int k = 0; k < n; ++k) {
+        mark[k] = k;
+        for (int p = outer[perm[k]]; p < outer[perm[k] + 1]; ++p) {
+            for (int i = invPerm[inner[p]]; i < k && mark[i] != k; i = parent[i]) {
+                if (parent[i] == -1) parent[i] = k;
+                ++count[i];
+                mark[i] = k;
+            }
+        }
+    }
+
+    // Postorder the tree so every subtree, and every chain that becomes a supernode, is a
+    // contiguous range of columns; children are visited in ascending order
+    vector<int> head(n, -1), next(n, -1), post, stack;
+    post.reserve(n);
+    for (int j = n - 1; j >= 0; --j) {
+        if (parent[j] == -1) continue;
+        next[j] = head[parent[j]];
+        head[parent[j]] = j;
+    }
+    for (int root = 0; root < n; ++root) {
+        if (parent[root] != -1) continue;
+        stack.push_back(root);
+        while (!stack.empty()) {
+            const int j = stack.back();
+            if (head[j] != -1) {
+                const int child = head[j];
+                head[j] = next[child];
+                stack.push_back(child);
+            } else {
+                stack.pop_back();
+                post.push_back(j);
+            }
+        }
+    }
+
+    vector<int> postInv(n);
+    for (int k = 0; k < n; ++k) postInv[post[k]] = k;
+
+    m_perm.resize(n);
+    m_invPerm.resize(n);
+    vector<int> postParent(n), postCount(n);
+    for (int k = 0; k < n; ++k) {
+        m_perm[k] = perm[post[k]];
+        m_invPerm[m_perm[k]] = k;
+        postParent[k] = parent[post[k]] == -1 ? -1 : postInv[parent[post[k]]];
+        postCount[k]  = count[post[k]];
+    }
+    parent.swap(postParent);
+    count.swap(postCount);
+
+    // Lower triangle of P A P^T by columns, remembering where each value lives in A
+    m_Cp.assign(n + 1, 0);
+    for (int j = 0; j < n; ++j) {
+        for (int p = outer[j]; p < outer[j + 1]; ++p) {
+            if (m_invPerm[inner[p]] >= m_invPerm[j]) ++m_Cp[m_invPerm[j] + 1];
+        }
+    }
+    for (int j = 0; j < n; ++j) m_Cp[j + 1] += m_Cp[j];
+
+    m_Ci.resize(m_Cp[n]);
+    m_Cmap.resize(m_Cp[n]);
+    vector<int> cursor(m_Cp.begin(), m_Cp.end() - 1);
+    for (int j = 0; j < n; ++j) {
+        for (int p = outer[j]; p < outer[j + 1]; ++p) {
+            const int i = m_invPerm[inner[p]];
+            if (i < m_invPerm[j]) continue;
+            const int q = cursor[m_invPerm[j]]++;
+            m_Ci[q]   = i;
+            m_Cmap[q] = p;
+        }
+    }
+
+    m_nonZeros = 0;
+    m_flops    = 0;
+    for (int j = 0; j < n; ++j) {
+        m_nonZeros += count[j];
+        m_flops    += double(count[j]) * (count[j] + 3);
+    }
+
+    // Supernodes: a column joins the previous one's supernode when it is that column's
+    // parent and the block's explicit zeros stay within RELAXED_ZEROS. Along such a chain
+    // each column's pattern lies within the next one's, so the block's rows are the
+    // supernode's own columns followed by the pattern of its last column.
+    m_first.assign(1, 0);
+    double actual = n > 0 ? count[0] + 1 : 0;
+    for (int j = 1; j < n; ++j) {
+        const int    f       = m_first.back();
+        const double columns = j - f + 1;
+        const double stored  = columns * (columns + count[j]) - columns * (columns - 1) / 2;
+        const bool   chained = parent[j - 1] == j;
+        const bool   exact   = count[j - 1] == count[j] + 1;
+
+        if (chained && (exact || stored - (actual + count[j] + 1) <= RELAXED_ZEROS * stored)) {
+            actual += count[j] + 1;
+        } else {
+            m_first.push_back(j);
+            actual = count[j] + 1;
+        }
+    }
+    if (n > 0) m_first.push_back(n);
+    const int supernodeCount = m_first.size() - 1;
+
+    vector<int> owner(n);
+    for (int s = 0; s < supernodeCount; ++s) {
+        for (int j = m_first[s]; j < m_first[s + 1]; ++j) owner[j] = s;
+    }
+    m_superParent.assign(supernodeCount, -1);
+    for (int s = 0; s < supernodeCount; ++s) {
+        const int p = parent[m_first[s + 1] - 1];
+        m_superParent[s] = p == -1 ? -1 : owner[p];
+    }
+
+    // Rows of each supernode, from A's entries below its last column and the rows of its
+    // child supernodes below it; children come first in postorder
+    m_rowStart.assign(supernodeCount + 1, 0);
+    for (int s = 0; s < supernodeCount; ++s) {
+        const int last = m_first[s + 1] - 1;
+        m_rowStart[s + 1] = m_rowStart[s] + (m_first[s + 1] - m_first[s]) + count[last];
+    }
+    m_rows.resize(m_rowStart[supernodeCount]);
+
+    vector<int> childHead(supernodeCount, -1), childNext(supernodeCount, -1);
+    for (int s = supernodeCount - 1; s >= 0; --s) {
+        if (m_superParent[s] == -1) continue;
+        childNext[s] = childHead[m_superParent[s]];
+        childHead[m_superParent[s]] = s;
+    }
+
+    mark.assign(n, -1);
+    for (int s = 0; s < supernodeCount; ++s) {
+        const int f = m_first[s], last = m_first[s + 1] - 1;
+        int *rows = &m_rows[m_rowStart[s]];
+        int  size = 0;
+        for (int j = f; j <= last; ++j) rows[size++] = j;
+
+        auto add = [&](int i) {
+            if (i > last && mark[i] != s) {
+                mark[i] = s;
+                rows[size++] = i;
+            }
+        };
+        for (int j = f; j <= last; ++j) {
+            for (int p = m_Cp[j]; p < m_Cp[j + 1]; ++p) add(m_Ci[p]);
+        }
+        for (int c = childHead[s]; c != -1; c = childNext[c]) {
+            const int columns = m_first[c + 1] - m_first[c];
+            for (int r = m_rowStart[c] + columns; r < m_rowStart[c + 1]; ++r) add(m_rows[r]);
+        }
+        sort(rows + (last - f + 1), rows + size);
+    }
+
+    m_blockStart.assign(supernodeCount + 1, 0);
+    for (int s = 0; s < supernodeCount; ++s) {
+        const long columns = m_first[s + 1] - m_first[s];
+        m_blockStart[s + 1] = m_blockStart[s] + columns * (m_rowStart[s + 1] - m_rowStart[s]);
+    }
+    m_values.assign(m_blockStart[supernodeCount], 0.0);
+
+    // Each supernode d updates the supernodes owning its rows below its own columns; the
+    // rows for one target are contiguous, so the first of them is all that needs keeping
+    m_updateStart.assign(supernodeCount + 1, 0);
+    for (int pass = 0; pass < 2; ++pass) {
+        vector<int> fill(m_updateStart.begin(), m_updateStart.end() - 1);
+        for (int d = 0; d < supernodeCount; ++d) {
+            const int columns = m_first[d + 1] - m_first[d];
+            int target = -1;
+            for (int r = m_rowStart[d] + columns; r < m_rowStart[d + 1]; ++r) {
+                if (owner[m_rows[r]] == target) continue;
+                target = owner[m_rows[r]];
+                if (pass == 0) {
+                    ++m_updateStart[target + 1];
+                } else {
+                    m_updateSource[fill[target]] = d;
+                    m_updateOffset[fill[target]] = r - m_rowStart[d];
+                    ++fill[target];
+                }
+            }
+        }
+        if (pass == 0) {
+            for (int s = 0; s < supernodeCount; ++s) m_updateStart[s + 1] += m_updateStart[s];
+            m_updateSource.resize(m_updateStart[supernodeCount]);
+            m_updateOffset.resize(m_updateStart[supernodeCount]);
+        }
+    }
+
+    // Subtree extents and work, for splitting the tree across threads
+    m_subtreeFirst.resize(supernodeCount);
+    m_subtreeWork.assign(supernodeCount, 0.0);
+    for (int s = 0; s < supernodeCount; ++s) m_subtreeFirst[s] = s;
+    for (int s = 0; s < supernodeCount; ++s) {
+        const double columns = m_first[s + 1] - m_first[s];
+        const double rows    = m_rowStart[s + 1] - m_rowStart[s];
+        m_subtreeWork[s] += columns * rows * rows;
+        if (m_superParent[s] != -1) {
+            m_subtreeFirst[m_superParent[s]] = min(m_subtreeFirst[m_superParent[s]], m_subtreeFirst[s]);
+            m_subtreeWork[m_superParent[s]]  += m_subtreeWork[s];
+        }
+    }
+
+    m_work.assign(n, 0.0);
+    m_blockWork.resize(n, 3);
+}
+
+double SupernodalLLT::workSpanRatio() const
+{
+    // Children come before their parents in postorder, so each supernode has seen the
+    // heaviest chain below it by the time it adds its own work
+    const int supernodeCount = supernodes();
+    vector<double> span(supernodeCount, 0.0);
+    double total    = 0;
+    double critical = 0;
+
+    for (int s = 0; s < supernodeCount; ++s) {
+        const double columns = m_first[s + 1] - m_first[s];
+        const double rows    = m_rowStart[s + 1] - m_rowStart[s];
+        total   += columns * rows * rows;
+        span[s] += columns * rows * rows;
+
+        if (m_superParent[s] == -1) critical = max(critical, span[s]);
+        else span[m_superParent[s]] = max(span[m_superParent[s]], span[s]);
+    }
+    return critical > 0 ? total / critical : 1.0;
+}
+
+// ================== Numeric Factorization
+
+bool SupernodalLLT::factorize(const SparseMatrix<double> &A, ThreadPool &pool)
+{
+    const int supernodeCount = supernodes();
+    const double *values = A.valuePtr();
+    const int threads = pool.getThreadCount();
+
+    if (threads == 1) {
+        for (int s = 0; s < supernodeCount; ++s) {
+            if (!factorSupernode(s, values, nullptr)) return false;
+        }
+        return true;
+    }
+
+    // Split the tree: keep replacing the heaviest subtree by its children, moving its root
+    // to the top part, until there are a few subtrees per thread or only leaves are left
+    auto lighter = [this](int a, int b) { return m_subtreeWork[a] < m_subtreeWork[b]; };
+    priority_queue<int, vector<int>, decltype(lighter)> subtrees(lighter);
+    for (int r = supernodeCount - 1; r >= 0; r = m_subtreeFirst[r] - 1) subtrees.push(r);
+
+    vector<int> top;
+    while ((int) subtrees.size() < 4 * threads && !subtrees.empty()) {
+        const int r = subtrees.top();
+        if (m_subtreeFirst[r] == r) break;
+        subtrees.pop();
+        top.push_back(r);
+        for (int c = r - 1; c >= m_subtreeFirst[r]; c = m_subtreeFirst[c] - 1) subtrees.push(c);
+    }
+
+    // Heaviest first, so the stragglers are small
+    vector<int> roots;
+    for (; !subtrees.empty(); subtrees.pop()) roots.push_back(subtrees.top());
+
+    atomic<bool> ok(true);
+    pool.parallelFor(0, roots.size(), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            for (int s = m_subtreeFirst[roots[i]]; s <= roots[i]; ++s) {
+                if (!factorSupernode(s, values, nullptr)) ok = false;
+            }
+        }
+    }, 1);
+    if (!ok) return false;
+
+    // The separators above the subtrees, children before parents, each with its rows split
+    // across the pool
+    sort(top.begin(), top.end());
+    for (int s : top) {
+        if (!factorSupernode(s, values, &pool)) return false;
+    }
+    return true;
+}
+
+bool SupernodalLLT::factorSupernode(int s, const double *values, ThreadPool *pool)
+{
+    const int  f       = m_first[s];
+    const int  columns = m_first[s + 1] - f;
+    const int  rowCount = m_rowStart[s + 1] - m_rowStart[s];
+    const int *rows    = &m_rows[m_rowStart[s]];
+
+    Map<MatrixXd> block(&m_values[m_blockStart[s]], rowCount, columns);
+    block.setZero();
+
+    if ((int) t_local.size() < m_n) t_local.resize(m_n);
+    int *local = t_local.data();
+    for (int r = 0; r < rowCount; ++r) local[rows[r]] = r;
+
+    for (int j = f; j < f + columns; ++j) {
+        for (int p = m_Cp[j]; p < m_Cp[j + 1]; ++p) block(local[m_Ci[p]], j - f) = values[m_Cmap[p]];
+    }
+
+    // Block rows [begin, end) -= L_d(those rows) L_d(our columns)^T for each descendant d
+    auto gather = [&](int begin, int end) {
+        MatrixXd product;
+        const int firstRow = rows[begin];
+        const int endRow   = end < rowCount ? rows[end] : INT_MAX;
+
+        for (int k = m_updateStart[s]; k < m_updateStart[s + 1]; ++k) {
+            const int  d       = m_updateSource[k];
+            const int  dRows   = m_rowStart[d + 1] - m_rowStart[d];
+            const int *dRow    = &m_rows[m_rowStart[d]];
+            const int  p       = m_updateOffset[k];
+
+            int q = p;
+            while (q < dRows && dRow[q] < f + columns) ++q;
+            const int i0 = lower_bound(dRow + p, dRow + dRows, firstRow) - dRow;
+            const int i1 = lower_bound(dRow + i0, dRow + dRows, endRow) - dRow;
+            if (i0 >= i1) continue;
+
+            Map<const MatrixXd> source(&m_values[m_blockStart[d]], dRows, m_first[d + 1] - m_first[d]);
+            product.noalias() = source.middleRows(i0, i1 - i0) * source.middleRows(p, q - p).transpose();
+
+            for (int jj = 0; jj < q - p; ++jj) {
+                double *column = &block(0, dRow[p + jj] - f);
+                for (int ii = 0; ii < i1 - i0; ++ii) column[local[dRow[i0 + ii]]] -= product(ii, jj);
+            }
+        }
+    };
+    if (pool && rowCount > 2 * ROW_GRAIN) pool->parallelFor(0, rowCount, gather, ROW_GRAIN);
+    else                                  gather(0, rowCount);
+
+    // Dense Cholesky of the diagonal block, then L_21 = A_21 L_11^-T
+    Ref<MatrixXd> diagonal = block.topRows(columns);
+    LLT<Ref<MatrixXd>> llt(diagonal);
+    if (llt.info() != Success) return false;
+
+    const int below = rowCount - columns;
+    auto solve = [&](int begin, int end) {
+        auto rhs = block.middleRows(columns + begin, end - begin);
+        diagonal.transpose().triangularView<Upper>().solveInPlace<OnTheRight>(rhs);
+    };
+    if (pool && below > 2 * ROW_GRAIN) pool->parallelFor(0, below, solve, ROW_GRAIN);
+    else if (below > 0)                solve(0, below);
+
+    return true;
+}
+
+// ================== Solving
+
+// Forward and back substitution supernode by supernode. Every column of a supernode
+// shares the block's row list, so one pass down a column covers its diagonal block and
+// everything below it.
+void SupernodalLLT::solveInPlace(VectorXd &b) const
+{
+    const int supernodeCount = supernodes();
+    double *y = m_work.data();
+
+    for (int k = 0; k < m_n; ++k) y[k] = b[m_perm[k]];
+
+    for (int s = 0; s < supernodeCount; ++s) {
+        const int     f        = m_first[s];
+        const int     width    = m_first[s + 1] - f;
+        const int     rowCount = m_rowStart[s + 1] - m_rowStart[s];
+        const int    *rows     = &m_rows[m_rowStart[s]];
+        const double *block    = &m_values[m_blockStart[s]];
+
+        for (int c = 0; c < width; ++c) {
+            const double *column = block + long(c) * rowCount;
+            const double  y0     = y[f + c] /= column[c];
+            for (int r = c + 1; r < rowCount; ++r) y[rows[r]] -= column[r] * y0;
+        }
+    }
+    for (int s = supernodeCount - 1; s >= 0; --s) {
+        const int     f        = m_first[s];
+        const int     width    = m_first[s + 1] - f;
+        const int     rowCount = m_rowStart[s + 1] - m_rowStart[s];
+        const int    *rows     = &m_rows[m_rowStart[s]];
+        const double *block    = &m_values[m_blockStart[s]];
+
+        for (int c = width - 1; c >= 0; --c) {
+            const double *column = block + long(c) * rowCount;
+            double y0 = y[f + c];
+            for (int r = c + 1; r < rowCount; ++r) y0 -= column[r] * y[rows[r]];
+            y[f + c] = y0 / column[c];
+        }
+    }
+
+    for (int k = 0; k < m_n; ++k) b[m_perm[k]] = y[k];
+}
+
+void SupernodalLLT::solveInPlace(MatrixX3dRow &B) const
+{
+    const int supernodeCount = supernodes();
+    double *y = m_blockWork.data();
+
+    for (int k = 0; k < m_n; ++k) m_blockWork.row(k) = B.row(m_perm[k]);
+
+    for (int s = 0; s < supernodeCount; ++s) {
+        const int     f        = m_first[s];
+        const int     width    = m_first[s + 1] - f;
+        const int     rowCount = m_rowStart[s + 1] - m_rowStart[s];
+        const int    *rows     = &m_rows[m_rowStart[s]];
+        const double *block    = &m_values[m_blockStart[s]];
+
+        for (int c = 0; c < width; ++c) {
+            const double *column = block + long(c) * rowCount;
+            const double  d      = column[c];
+            double *yc = y + 3 * (f + c);
+            const double y0 = yc[0] /= d, y1 = yc[1] /= d, y2 = yc[2] /= d;
+            for (int r = c + 1; r < rowCount; ++r) {
+                double *row = y + 3 * rows[r];
+                const double l = column[r];
+                row[0] -= l * y0;
+                row[1] -= l * y1;
+                row[2] -= l * y2;
+            }
+        }
+    }
+    for (int s = supernodeCount - 1; s >= 0; --s) {
+        const int     f        = m_first[s];
+        const int     width    = m_first[s + 1] - f;
+        const int     rowCount = m_rowStart[s + 1] - m_rowStart[s];
+        const int    *rows     = &m_rows[m_rowStart[s]];
+        const double *block    = &m_values[m_blockStart[s]];
+
+        for (int c = width - 1; c >= 0; --c) {
+            const double *column = block + long(c) * rowCount;
+            const double  d      = column[c];
+            double *yc = y + 3 * (f + c);
+            double y0 = yc[0], y1 = yc[1], y2 = yc[2];
+            for (int r = c + 1; r < rowCount; ++r) {
+                const double *row = y + 3 * rows[r];
+                const double l = column[r];
+                y0 -= l * row[0];
+                y1 -= l * row[1];
+                y2 -= l * row[2];
+            }
+            yc[0] = y0 / d; yc[1] = y1 / d; yc[2] = y2 / d;
+        }
+    }
+
+    for (int k = 0; k < m_n; ++k) B.row(m_perm[k]) = m_blockWork.row(k);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+
+#define EIGEN_DONT_VECTORIZE
+#define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
+#include "Eigen/Dense"
+#include "Eigen/Sparse"
+
+#include "solver/fillordering.h"
+#include "solver/laplacian.h"
+
+class ThreadPool;
+
+// Supernodal sparse Cholesky factorization of a symmetric positive definite matrix,
+// P A P^T = L L^T, as an alternative to SparseLDLT for full refactorizations.
+//
+// The symbolic analysis postorders the elimination tree and groups chains of columns
+// with (nearly) the same pattern into supernodes, each stored as one dense column-major
+// block. factorize() is left-looking: a supernode gathers the updates of the descendants
+// that touch its columns with dense products, then factors its diagonal block and solves
+// for the rest of the block. Disjoint subtrees of the supernodal tree are factored in
+// parallel, and the separators above them one at a time with their rows split across
+// the pool. There are no row modifications; every anchor change is a full factorization.
+//
+// The speedup over threads has not been measured yet, only bounded by workSpanRatio().
+class SupernodalLLT
+{
+public:
+    SupernodalLLT();
+
+    void analyzePattern(const Eigen::SparseMatrix<double> &A, FillOrdering ordering = FillOrdering::MinimumDegree);
+    bool factorize(const Eigen::SparseMatrix<double> &A, ThreadPool &pool);
+
+    // Solves A x = b, overwriting b with x
+    void solveInPlace(Eigen::VectorXd &b) const;
+    void solveInPlace(MatrixX3dRow &B) const;
+
+    // nonZeros() and flops() count the strictly lower factor as SparseLDLT does, leaving
+    // out the explicit zeros of relaxed supernodes, so the two can be compared directly
+    int    rows()          const { return m_n; }
+    long   nonZeros()      const { return m_nonZeros; }
+    double flops()         const { return m_flops; }
+    int    supernodes()    const { return m_first.empty() ? 0 : m_first.size() - 1; }
+    long   storedEntries() const { return m_blockStart.empty() ? 0 : m_blockStart.back(); }
+
+    // Dense work of the whole factorization over that of its heaviest leaf-to-root chain of
+    // supernodes: the speedup the tree-parallel factorization can reach with every
+    // supernode on one thread. Separators split by rows across the pool can beat it.
+    double workSpanRatio() const;
+
+private:
+    // Merging a column into its parent's supernode is allowed while explicit zeros stay
+    // below this fraction of the block
+    static constexpr double RELAXED_ZEROS = 0.2;
+
+    // Rows per task when a supernode's updates and triangular solve are split up
+    static const int ROW_GRAIN = 64;
+
+    int m_n;
+
+    // Fill-reducing permutation composed with the etree postorder: m_perm[new] = old
+    std::vector<int> m_perm;
+    std::vector<int> m_invPerm;
+
+    // Lower triangle of P A P^T by columns, with each entry's position in A's value array
+    std::vector<int> m_Cp;
+    std::vector<int> m_Ci;
+    std::vector<int> m_Cmap;
+
+    // Supernode s holds columns [m_first[s], m_first[s + 1]) and the rows
+    // m_rows[m_rowStart[s] .. m_rowStart[s + 1]), its own columns first, as a dense
+    // column-major block at m_values[m_blockStart[s]]
+    std::vector<int>    m_first;
+    std::vector<int>    m_rowStart;
+    std::vector<int>    m_rows;
+    std::vector<long>   m_blockStart;
+    std::vector<double> m_values;
+
+    // Descendants updating supernode s: m_updateSource[k] with its rows from
+    // m_updateOffset[k] on, for k in [m_updateStart[s], m_updateStart[s + 1])
+    std::vector<int> m_updateStart;
+    std::vector<int> m_updateSource;
+    std::vector<int> m_updateOffset;
+
+    // Supernodal tree, the first supernode of each subtree (subtrees are contiguous in
+    // postorder), and the dense flops of each subtree for scheduling
+    std::vector<int>    m_superParent;
+    std::vector<int>    m_subtreeFirst;
+    std::vector<double> m_subtreeWork;
+
+    long   m_nonZeros;
+    double m_flops;
+
+    mutable MatrixX3dRow        m_blockWork;
+    mutable std::vector<double> m_work;
+
+    bool factorSupernode(int s, const double *values, ThreadPool *pool);
+};
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cmath>
+#include <type_traits>
+
+// Branch-free 3x3 rotation fitting, written once for any lane type that supports the
+// arithmetic operators and ?: selection: a plain double, or a GCC/Clang vector of
+// doubles. Every lane runs exactly the same sequence of correctly-rounded operations (no
+// estimates, no fused multiply-adds; kernel sources are built with -ffp-contract=off),
+// so a vertex gets bit-identical results whichever width processes it.
+//
+// For S = U Sigma V^T this returns R = V U^T with U and V both proper rotations, which
+// is the usual reflection fix of negating the column of the smallest singular value.
+//
+// This header is also compiled into the AVX2 and AVX-512 sources, so it includes no Eigen
+// and keeps everything in an unnamed namespace: each translation unit gets its own copy,
+// built for its own ISA, and the linker never has to pick one of several inline copies.
+namespace svdkernel {
+namespace {
+
+// Cyclic Jacobi sweeps on S^T S; convergence is quadratic, so this is past double precision
+const int JACOBI_SWEEPS = 4;
+
+template<typename Lane> inline Lane broadcast(double x) { return Lane{} + x; }
+
+template<typename Lane> inline double &lane(Lane &x, int l)
+{
+    if constexpr (std::is_same_v<Lane, double>) { (void)l; return x; }
+    else return reinterpret_cast<double *>(&x)[l];
+}
+
+template<typename Lane> inline Lane laneAbs(Lane x) { return x < 0 ? -x : x; }
+
+template<typename Lane> inline Lane laneSqrt(Lane x)
+{
+    if constexpr (std::is_same_v<Lane, double>) return std::sqrt(x);
+    else {
+        for (unsigned l = 0; l < sizeof(Lane) / sizeof(double); ++l) x[l] = std::sqrt(x[l]);
+        return x;
+    }
+}
+
+// One Jacobi rotation zeroing b[p][q] of the symmetric 3x3 b, accumulated into v
+template<typename Lane>
+inline void rotate(Lane b[3][3], Lane v[3][3], int p, int q)
+{
+    const int r = 3 - p - q;
+    const Lane apq  = b[p][q];
+    const auto flat = apq == 0;
+
+    const Lane tau = (b[q][q] - b[p][p]) / (flat ? broadcast<Lane>(1) : apq + apq);
+    const Lane mag = 1.0 / (laneAbs(tau) + laneSqrt(1.0 + tau * tau));
+    const Lane t   = flat ? broadcast<Lane>(0) : (tau < 0 ? -mag : mag);
+    const Lane c   = 1.0 / laneSqrt(1.0 + t * t);
+    const Lane s   = t * c;
+
+    b[p][p] = b[p][p] - t * apq;
+    b[q][q] = b[q][q] + t * apq;
+    b[p][q] = b[q][p] = broadcast<Lane>(0);
+
+    const Lane brp = b[r][p];
+    const Lane brq = b[r][q];
+    b[r][p] = b[p][r] = c * brp - s * brq;
+    b[r][q] = b[q][r] = s * brp + c * brq;
+
+    for (int k = 0; k < 3; ++k) {
+        const Lane vkp = v[k][p];
+        const Lane vkq = v[k][q];
+        v[k][p] = c * vkp - s * vkq;
+        v[k][q] = s * vkp + c * vkq;
+    }
+}
+
+// Orders eigenvalues i < j descending, carrying the eigenvector columns along
+template<typename Lane>
+inline void sortPair(Lane lambda[3], Lane v[3][3], int i, int j)
+{
+    const auto swap = lambda[i] < lambda[j];
+    const Lane li = lambda[i];
+    lambda[i] = swap ? lambda[j] : li;
+    lambda[j] = swap ? li : lambda[j];
+    for (int k = 0; k < 3; ++k) {
+        const Lane vi = v[k][i];
+        v[k][i] = swap ? v[k][j] : vi;
+        v[k][j] = swap ? vi : v[k][j];
+    }
+}
+
+// a and r are row-major 3x3 matrices, one per lane
+template<typename Lane>
+inline void fitRotation(const Lane a[9], Lane r[9])
+{
+    const Lane zero = broadcast<Lane>(0);
+    const Lane one  = broadcast<Lane>(1);
+
+    // Right singular vectors: eigenvectors of A^T A
+    Lane b[3][3];
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) b[i][j] = a[i] * a[j] + a[3 + i] * a[3 + j] + a[6 + i] * a[6 + j];
+    }
+
+    Lane v[3][3] = {{one, zero, zero}, {zero, one, zero}, {zero, zero, one}};
+    for (int sweep = 0; sweep < JACOBI_SWEEPS; ++sweep) {
+        rotate(b, v, 0, 1);
+        rotate(b, v, 1, 2);
+        rotate(b, v, 0, 2);
+    }
+
+    Lane lambda[3] = {b[0][0], b[1][1], b[2][2]};
+    sortPair(lambda, v, 0, 1);
+    sortPair(lambda, v, 0, 2);
+    sortPair(lambda, v, 1, 2);
+
+    // Make V a proper rotation
+    const Lane det = v[0][0] * (v[1][1] * v[2][2] - v[1][2] * v[2][1])
+                   - v[0][1] * (v[1][0] * v[2][2] - v[1][2] * v[2][0])
+                   + v[0][2] * (v[1][0] * v[2][1] - v[1][1] * v[2][0]);
+    for (int k = 0; k < 3; ++k) v[k][2] = det < 0 ? -v[k][2] : v[k][2];
+
+    // Left singular vectors by Gram-Schmidt on A V; u2 = u0 x u1 keeps U proper, which
+    // lets sigma_2 go negative instead of R becoming a reflection
+    const Lane norm = a[0] * a[0] + a[1] * a[1] + a[2] * a[2] + a[3] * a[3] + a[4] * a[4]
+                    + a[5] * a[5] + a[6] * a[6] + a[7] * a[7] + a[8] * a[8];
+    const Lane tiny = norm * 1e-20;
+
+    Lane av[3][2];
+    for (int i = 0; i < 3; ++i) {
+        for (int k = 0; k < 2; ++k) av[i][k] = a[3 * i] * v[0][k] + a[3 * i + 1] * v[1][k] + a[3 * i + 2] * v[2][k];
+    }
+
+    // Rank-deficient columns fall back to V's, so S = 0 yields R = I
+    Lane u0[3];
+    const Lane len0 = av[0][0] * av[0][0] + av[1][0] * av[1][0] + av[2][0] * av[2][0];
+    const auto degenerate0 = len0 <= tiny;
+    const Lane inv0 = 1.0 / laneSqrt(degenerate0 ? one : len0);
+    for (int i = 0; i < 3; ++i) u0[i] = degenerate0 ? v[i][0] : av[i][0] * inv0;
+
+    Lane u1[3];
+    const Lane dot1 = u0[0] * av[0][1] + u0[1] * av[1][1] + u0[2] * av[2][1];
+    for (int i = 0; i < 3; ++i) u1[i] = av[i][1] - dot1 * u0[i];
+    const Lane len1 = u1[0] * u1[0] + u1[1] * u1[1] + u1[2] * u1[2];
+    const auto degenerate1 = len1 <= tiny;
+
+    // Fallback for u1: V's second column, or failing that u0 crossed with a far axis
+    Lane w[3];
+    const Lane dotV = u0[0] * v[0][1] + u0[1] * v[1][1] + u0[2] * v[2][1];
+    for (int i = 0; i < 3; ++i) w[i] = v[i][1] - dotV * u0[i];
+    const Lane lenW = w[0] * w[0] + w[1] * w[1] + w[2] * w[2];
+    const auto xFar = laneAbs(u0[0]) < 0.5;
+    const Lane cross[3] = {xFar ? zero : -u0[2], xFar ? u0[2] : zero, xFar ? -u0[1] : u0[0]};
+    const auto degenerateW = lenW <= 1e-6;
+    for (int i = 0; i < 3; ++i) w[i] = degenerateW ? cross[i] : w[i];
+    const Lane lenFallback = w[0] * w[0] + w[1] * w[1] + w[2] * w[2];
+
+    const Lane inv1 = 1.0 / laneSqrt(degenerate1 ? lenFallback : len1);
+    for (int i = 0; i < 3; ++i) u1[i] = (degenerate1 ? w[i] : u1[i]) * inv1;
+
+    const Lane u2[3] = {u0[1] * u1[2] - u0[2] * u1[1],
+                        u0[2] * u1[0] - u0[0] * u1[2],
+                        u0[0] * u1[1] - u0[1] * u1[0]};
+
+    // R = V U^T
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) r[3 * i + j] = v[i][0] * u0[j] + v[i][1] * u1[j] + v[i][2] * u2[j];
+    }
+}
+
+// Fits rotations for the first count - count % W matrices, W at a time, and returns how
+// many were done. The remainder is left to a narrower width. Matrices are packed as 9
+// column-major doubles each, Eigen::Matrix3d's layout; rotations may alias covariances.
+template<typename Lane>
+inline int fitRotationBlocks(const double *covariances, double *rotations, int count)
+{
+    constexpr int W = sizeof(Lane) / sizeof(double);
+    const int blocked = count - count % W;
+
+    for (int first = 0; first < blocked; first += W) {
+        Lane a[9], r[9];
+        for (int l = 0; l < W; ++l) {
+            for (int e = 0; e < 9; ++e) lane(a[e], l) = covariances[9 * (first + l) + 3 * (e % 3) + e / 3];
+        }
+
+        fitRotation(a, r);
+
+        for (int l = 0; l < W; ++l) {
+            for (int e = 0; e < 9; ++e) rotations[9 * (first + l) + 3 * (e % 3) + e / 3] = lane(r[e], l);
+        }
+    }
+
+    return blocked;
+}
+
+}
+}
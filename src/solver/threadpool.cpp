@@ -0,0 +1,168 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// Set on pool threads and on callers while they run a job, so nested loops run inline
+static thread_local bool t_insideJob = false;
+
+ThreadPool::ThreadPool(int threads) :
+    m_generation(0),
+    m_stopping(false),
+    m_body(nullptr),
+    m_pending(0)
+{
+    start(threads);
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+void ThreadPool::setThreadCount(int threads)
+{
+    lock_guard<mutex> job(m_jobMutex);
+    stop();
+    start(threads);
+}
+
+void ThreadPool::start(int threads)
+{
+    if (threads <= 0) threads = max(1u, thread::hardware_concurrency());
+
+    m_stopping = false;
+    m_queues.clear();
+    for (int q = 0; q < threads; ++q) m_queues.push_back(make_unique<Queue>());
+
+    // Queue 0 belongs to whichever thread calls parallelFor()
+    for (int q = 1; q < threads; ++q) m_workers.emplace_back(&ThreadPool::workerLoop, this, q);
+}
+
+void ThreadPool::stop()
+{
+    {
+        lock_guard<mutex> state(m_stateMutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    for (thread &worker : m_workers) worker.join();
+    m_workers.clear();
+}
+
+// ================== Scheduling
+
+void ThreadPool::parallelFor(int begin, int end, const function<void(int, int)> &body, int grain)
+{
+    const int count = end - begin;
+    if (count <= 0) return;
+
+    if (t_insideJob) {
+        body(begin, end);
+        return;
+    }
+
+    // Another thread (e.g. the render thread while the solver runs) already owns the
+    // pool: run serially rather than stall behind its job
+    unique_lock<mutex> job(m_jobMutex, try_to_lock);
+    if (!job.owns_lock()) {
+        body(begin, end);
+        return;
+    }
+    t_insideJob = true;
+
+    // A few chunks per thread leaves room for stealing to even out the load
+    const int threads = getThreadCount();
+    const int chunks  = min(max(1, count / max(1, grain)), 4 * threads);
+    if (chunks == 1 || threads == 1) {
+        body(begin, end);
+        t_insideJob = false;
+        return;
+    }
+
+    m_body = &body;
+    m_pending = chunks;
+
+    const int chunkSize = count / chunks;
+    const int remainder = count % chunks;
+    int chunkBegin = begin;
+    for (int c = 0; c < chunks; ++c) {
+        const int chunkEnd = chunkBegin + chunkSize + (c < remainder ? 1 : 0);
+        Queue &queue = *m_queues[c % threads];
+        lock_guard<mutex> lock(queue.mutex);
+        queue.ranges.push_back({chunkBegin, chunkEnd});
+        chunkBegin = chunkEnd;
+    }
+
+    {
+        lock_guard<mutex> state(m_stateMutex);
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    drain(0);
+
+    unique_lock<mutex> state(m_stateMutex);
+    m_done.wait(state, [this] { return m_pending.load() == 0; });
+
+    m_body = nullptr;
+    t_insideJob = false;
+}
+
+void ThreadPool::workerLoop(int queue)
+{
+    t_insideJob = true;
+    unsigned long seen = 0;
+
+    while (true) {
+        {
+            unique_lock<mutex> state(m_stateMutex);
+            m_wake.wait(state, [&] { return m_stopping || m_generation != seen; });
+            if (m_stopping) return;
+            seen = m_generation;
+        }
+        drain(queue);
+    }
+}
+
+// Works through the thread's own deque from the back, then steals from the front of others
+void ThreadPool::drain(int queue)
+{
+    Range range;
+    while (take(queue, range)) {
+        (*m_body)(range.begin, range.end);
+
+        if (--m_pending == 0) {
+            lock_guard<mutex> state(m_stateMutex);
+            m_done.notify_all();
+        }
+    }
+}
+
+bool ThreadPool::take(int queue, Range &range)
+{
+    {
+        Queue &own = *m_queues[queue];
+        lock_guard<mutex> lock(own.mutex);
+        if (!own.ranges.empty()) {
+            range = own.ranges.back();
+            own.ranges.pop_back();
+            return true;
+        }
+    }
+
+    const int queues = m_queues.size();
+    for (int offset = 1; offset < queues; ++offset) {
+        Queue &victim = *m_queues[(queue + offset) % queues];
+        lock_guard<mutex> lock(victim.mutex);
+        if (!victim.ranges.empty()) {
+            range = victim.ranges.front();
+            victim.ranges.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
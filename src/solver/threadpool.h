@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent work-stealing pool for the data-parallel loops of the solver. Workers are
+// started once and sleep between jobs; parallelFor() chunks an index range, deals the
+// chunks out to per-thread deques, and idle threads steal from the others' deques so
+// uneven chunks (e.g. high-valence vertices) still balance. The calling thread takes
+// part in the work, so a pool of n threads runs n - 1 workers.
+class ThreadPool
+{
+public:
+    // threads <= 0 uses every hardware thread
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void setThreadCount(int threads);
+    int  getThreadCount() const { return m_workers.size() + 1; }
+
+    // Runs body(chunkBegin, chunkEnd) over [begin, end) in chunks of at least grain
+    // indices, and returns once all of them are done. Calls made from inside a body, or
+    // while another thread has a job running, run serially on the calling thread.
+    void parallelFor(int begin, int end, const std::function<void(int, int)> &body, int grain = 256);
+
+private:
+    struct Range
+    {
+        int begin;
+        int end;
+    };
+
+    struct Queue
+    {
+        std::mutex        mutex;
+        std::deque<Range> ranges;
+    };
+
+    std::vector<std::thread>            m_workers;
+    std::vector<std::unique_ptr<Queue>> m_queues;
+
+    std::mutex              m_jobMutex;
+    std::mutex              m_stateMutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    unsigned long           m_generation;
+    bool                    m_stopping;
+
+    const std::function<void(int, int)> *m_body;
+    std::atomic<int>                     m_pending;
+
+    void start(int threads);
+    void stop();
+    void workerLoop(int queue);
+    void drain(int queue);
+    bool take(int queue, Range &range);
+};
@@ -0,0 +1,184 @@
+#include "vertexorder.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+using namespace std;
+using namespace Eigen;
+
+// Spreads the low 21 bits of x two bits apart, for interleaving three coordinates
+static uint64_t spreadBits(uint64_t x)
+{
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffff;
+    x = (x | x << 16) & 0x1f0000ff0000ff;
+    x = (x | x << 8)  & 0x100f00f00f00f00f;
+    x = (x | x << 4)  & 0x10c30c30c30c30c3;
+    x = (x | x << 2)  & 0x1249249249249249;
+    return x;
+}
+
+void VertexOrder::reverseCuthillMcKee(int n, const vector<Vector3i> &triangles, vector<int> &order)
+{
+    // Neighbor lists by vertex, each sorted and free of duplicates
+    vector<int> start(n + 1, 0);
+    for (const Vector3i &t : triangles) {
+        for (int k = 0; k < 3; ++k) start[t[k] + 1] += 2;
+    }
+    for (int i = 0; i < n; ++i) start[i + 1] += start[i];
+
+    vector<int> neighbors(start[n]);
+    vector<int> fill(start.begin(), start.end() - 1);
+    for (const Vector3i &t : triangles) {
+        for (int k = 0; k < 3; ++k) {
+            const int a = t[k], b = t[(k + 1) % 3];
+            neighbors[fill[a]++] = b;
+            neighbors[fill[b]++] = a;
+        }
+    }
+
+    int kept = 0;
+    for (int i = 0; i < n; ++i) {
+        auto first = neighbors.begin() + start[i];
+        auto last  = neighbors.begin() + start[i + 1];
+        sort(first, last);
+        last = unique(first, last);
+
+        start[i] = kept;
+        kept = copy(first, last, neighbors.begin() + kept) - neighbors.begin();
+    }
+    start[n] = kept;
+
+    auto degree = [&](int i) { return start[i + 1] - start[i]; };
+
+    vector<int>  distance(n, -1);
+    vector<char> ordered(n, 0);
+    vector<int>  queue;
+    vector<int>  next;
+    queue.reserve(n);
+    order.clear();
+    order.reserve(n);
+
+    // Breadth-first search over the unordered vertices reachable from root; leaves the
+    // visit order in queue and returns the depth of the last level
+    auto levels = [&](int root) {
+        queue.clear();
+        queue.push_back(root);
+        distance[root] = 0;
+        for (unsigned long q = 0; q < queue.size(); ++q) {
+            const int v = queue[q];
+            for (int s = start[v]; s < start[v + 1]; ++s) {
+                const int w = neighbors[s];
+                if (distance[w] < 0 && !ordered[w]) {
+                    distance[w] = distance[v] + 1;
+                    queue.push_back(w);
+                }
+            }
+        }
+        return distance[queue.back()];
+    };
+    auto clearLevels = [&] {
+        for (int v : queue) distance[v] = -1;
+    };
+
+    for (int seed = 0; seed < n; ++seed) {
+        if (ordered[seed]) continue;
+
+        // George and Liu's pseudo-peripheral vertex: restart from the lowest-degree vertex
+        // of the deepest level for as long as that makes the level structure deeper
+        int root  = seed;
+        int depth = levels(root);
+        while (true) {
+            int candidate = -1;
+            for (int v : queue) {
+                if (distance[v] == depth && (candidate < 0 || degree(v) < degree(candidate))) candidate = v;
+            }
+            clearLevels();
+
+            const int candidateDepth = levels(candidate);
+            if (candidateDepth <= depth) {
+                clearLevels();
+                break;
+            }
+            root  = candidate;
+            depth = candidateDepth;
+        }
+
+        // Cuthill-McKee from there: breadth first, lowest degree first within a parent
+        const unsigned long first = order.size();
+        order.push_back(root);
+        ordered[root] = 1;
+        for (unsigned long q = first; q < order.size(); ++q) {
+            const int v = order[q];
+            next.clear();
+            for (int s = start[v]; s < start[v + 1]; ++s) {
+                const int w = neighbors[s];
+                if (!ordered[w]) {
+                    ordered[w] = 1;
+                    next.push_back(w);
+                }
+            }
+            sort(next.begin(), next.end(), [&](int a, int b) {
+                return degree(a) != degree(b) ? degree(a) < degree(b) : a < b;
+            });
+            order.insert(order.end(), next.begin(), next.end());
+        }
+    }
+
+    reverse(order.begin(), order.end());
+}
+
+void VertexOrder::morton(const vector<Vector3f> &vertices, vector<int> &order)
+{
+    const int n = vertices.size();
+    order.resize(n);
+    if (n == 0) return;
+
+    Vector3f lo = vertices[0], hi = vertices[0];
+    for (const Vector3f &v : vertices) {
+        lo = lo.cwiseMin(v);
+        hi = hi.cwiseMax(v);
+    }
+    const float extent = max((hi - lo).maxCoeff(), 1e-20f);
+    const double scale = double((1 << 21) - 1) / extent;
+
+    vector<pair<uint64_t, int>> keys(n);
+    for (int i = 0; i < n; ++i) {
+        const Vector3d cell = ((vertices[i] - lo).cast<double>() * scale).array().round();
+        keys[i].first  = spreadBits(uint64_t(cell.x())) | spreadBits(uint64_t(cell.y())) << 1 | spreadBits(uint64_t(cell.z())) << 2;
+        keys[i].second = i;
+    }
+    sort(keys.begin(), keys.end());
+
+    for (int k = 0; k < n; ++k) order[k] = keys[k].second;
+}
+
+void VertexOrder::apply(const vector<int> &order, vector<Vector3f> &vertices, vector<Vector3i> &triangles, vector<int> &rank)
+{
+    const int n = order.size();
+    rank.resize(n);
+    for (int k = 0; k < n; ++k) rank[order[k]] = k;
+
+    vector<Vector3f> permuted(n);
+    for (int k = 0; k < n; ++k) permuted[k] = vertices[order[k]];
+    vertices.swap(permuted);
+
+    // Renumbering keeps each triangle's winding; sorting them puts a vertex's triangles
+    // near each other for the passes that run over faces
+    for (Vector3i &t : triangles) t = Vector3i(rank[t[0]], rank[t[1]], rank[t[2]]);
+    stable_sort(triangles.begin(), triangles.end(), [](const Vector3i &a, const Vector3i &b) {
+        return a.minCoeff() < b.minCoeff();
+    });
+}
+
+double VertexOrder::meanEdgeSpan(const vector<Vector3i> &triangles)
+{
+    if (triangles.empty()) return 0.0;
+
+    double span = 0.0;
+    for (const Vector3i &t : triangles) {
+        span += abs(t[0] - t[1]) + abs(t[1] - t[2]) + abs(t[2] - t[0]);
+    }
+    return span / (3.0 * triangles.size());
+}
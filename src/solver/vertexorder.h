@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+#define EIGEN_DONT_VECTORIZE
+#define EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
+#include "Eigen/Dense"
+
+enum MeshOrdering
+{
+    LoadedOrder  = 0,
+    CuthillMcKee = 1,
+    MortonCurve  = 2
+};
+
+// Vertex orders that put the vertices of a one-ring close together in memory, so that
+// the per-vertex passes of the solver (local step, right-hand side, sparse products) touch
+// few cache lines per vertex. Orders are written as order[new] = old.
+//
+// Cache misses have not been measured. arap-bench only reports the edge span and wall
+// time, which barely change on the shipped meshes because they fit in cache anyway.
+class VertexOrder
+{
+public:
+    // Reverse Cuthill-McKee over the edges of the triangles: a breadth-first search from a
+    // pseudo-peripheral vertex of each connected component, taking neighbors by increasing
+    // degree, reversed. Keeps the index span of every edge (the bandwidth) small.
+    static void reverseCuthillMcKee(int vertexCount, const std::vector<Eigen::Vector3i> &triangles, std::vector<int> &order);
+
+    // Z-order of the vertices' positions quantized over their bounding box. Ignores the
+    // connectivity, so it is cheaper but leaves longer edges between octants.
+    static void morton(const std::vector<Eigen::Vector3f> &vertices, std::vector<int> &order);
+
+    // Permutes vertices and renumbers triangles to the given order, then sorts the
+    // triangles by their first vertex in it. Writes rank[old] = new.
+    static void apply(const std::vector<int> &order, std::vector<Eigen::Vector3f> &vertices,
+                      std::vector<Eigen::Vector3i> &triangles, std::vector<int> &rank);
+
+    // Mean index distance between the endpoints of an edge, a cheap measure of locality
+    static double meanEdgeSpan(const std::vector<Eigen::Vector3i> &triangles);
+
+private:
+    VertexOrder();
+};